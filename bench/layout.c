@@ -0,0 +1,68 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Times the layouts of layout.c at 1 to 10000 clients on a 2560x1440
+ * area, every client with terminal-like size hints, and prints the time
+ * per layout run and per client. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../layout.h"
+#include "../util.h"
+
+#define MAXN 10000
+#define LENGTH(X) (sizeof X / sizeof X[0])
+
+static const struct {
+	const char *name;
+	void (*fn)(const Tiling *, Rect *);
+} layouts[] = {
+	{ "tile",           lt_tile },
+	{ "grid",           lt_grid },
+	{ "deck",           lt_deck },
+	{ "centeredmaster", lt_centeredmaster },
+	{ "monocle",        lt_monocle },
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(void)
+{
+	static const int counts[] = { 1, 10, 100, 1000, 10000 };
+	static int bw[MAXN];
+	static const Hints *hints[MAXN];
+	static Rect r[MAXN];
+	Hints term = { 0, 0, 2, 2, 7, 15, 0, 0, 16, 32 };
+	Tiling t = { { 0, 0, 2560, 1440 }, 5, 1, 0.55, 1, 0, bw, hints };
+	volatile int sink = 0;
+	double t0, ns;
+	size_t l, c;
+	long i, runs;
+
+	for (i = 0; i < MAXN; i++) {
+		bw[i] = 1;
+		hints[i] = &term;
+	}
+	printf("%-16s %8s %12s %12s\n", "layout", "clients", "ns/run", "ns/client");
+	for (l = 0; l < LENGTH(layouts); l++)
+		for (c = 0; c < LENGTH(counts); c++) {
+			t.n = counts[c];
+			runs = MAX(10, 2000000 / t.n);
+			t0 = now();
+			for (i = 0; i < runs; i++) {
+				layouts[l].fn(&t, r);
+				sink += r[t.n - 1].w;
+			}
+			ns = (now() - t0) / runs;
+			printf("%-16s %8d %12.0f %12.1f\n", layouts[l].name, t.n, ns, ns / t.n);
+		}
+	return 0;
+}
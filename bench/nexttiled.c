@@ -0,0 +1,122 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Times a nexttiled() walk over 1000 clients taken from the client pool
+ * against the same clients allocated one by one with ecalloc(), as before
+ * the pool. Every client gets a title allocated right after it, as in
+ * manage(); half of them are on the viewed tag and every fourth floats.
+ * Walks are timed warm, repeated back to back, and cold, after the caches
+ * have been flushed by a pass over a buffer larger than them. */
+#define main dwm_main
+#include "../dwm.c"
+#undef main
+
+#include <time.h>
+
+#define NCLIENT 1000
+#define RUNS    20000
+#define FLUSH   (32 << 20)
+
+static Client *list[NCLIENT];
+static char *flushbuf;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+build(Monitor *m, int pooled)
+{
+	Client *c;
+	int i;
+
+	for (i = 0; i < NCLIENT; i++) {
+		c = list[i] = pooled ? pool_alloc(&clientpool) : ecalloc(1, sizeof(Client));
+		memset(c, 0, sizeof(Client));
+		c->name = ecalloc(1, 64 + i % 7 * 32);
+		c->mon = m;
+		c->tags = i % 2 ? 1 : 2;
+		c->isfloating = i % 4 == 0;
+		if (i)
+			list[i - 1]->next = c;
+	}
+	m->clients = list[0];
+}
+
+static void
+destroy(int pooled)
+{
+	int i;
+
+	for (i = 0; i < NCLIENT; i++) {
+		free(list[i]->name);
+		if (pooled)
+			pool_free(&clientpool, list[i]);
+		else
+			free(list[i]);
+	}
+}
+
+static int
+walk(Monitor *m)
+{
+	Client *c;
+	int n = 0;
+
+	for (c = nexttiled(m->clients); c; c = nexttiled(c->next))
+		n++;
+	return n;
+}
+
+static void
+flush(void)
+{
+	volatile char *p = flushbuf;
+	size_t i;
+
+	for (i = 0; i < FLUSH; i += 64)
+		p[i]++;
+}
+
+static void
+bench(Monitor *m, int pooled)
+{
+	volatile int sink = 0;
+	double t0, warm, cold = 0;
+	int i;
+
+	build(m, pooled);
+	t0 = now();
+	for (i = 0; i < RUNS; i++)
+		sink += walk(m);
+	warm = (now() - t0) / RUNS;
+	for (i = 0; i < 50; i++) {
+		flush();
+		t0 = now();
+		sink += walk(m);
+		cold += now() - t0;
+	}
+	cold /= 50;
+	printf("%-8s %8d %12.0f %12.1f %12.0f %12.1f\n", pooled ? "pool" : "ecalloc",
+		NCLIENT, warm, warm / NCLIENT, cold, cold / NCLIENT);
+	destroy(pooled);
+}
+
+int
+main(void)
+{
+	static Monitor m;
+
+	m.tagset[0] = 1;
+	flushbuf = ecalloc(1, FLUSH);
+	printf("%-8s %8s %12s %12s %12s %12s\n", "alloc", "clients",
+		"warm ns", "ns/client", "cold ns", "ns/client");
+	bench(&m, 0);
+	bench(&m, 1);
+	free(flushbuf);
+	return 0;
+}
@@ -0,0 +1,89 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Times applyrules() over 500 rules, 480 of them for an exact class and
+ * 20 glob patterns, against a scan of all of them in order, for windows
+ * whose class has a rule and windows whose class has none. */
+#define main dwm_main
+#include "../dwm.c"
+#undef main
+
+#include <time.h>
+
+#define NRULE 500
+#define NGLOB 20
+#define RUNS  200000
+
+static Rule set[NRULE];
+static char names[NRULE][16];
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+scanrules(Client *c, Props *p)
+{
+	int i;
+
+	c->isfloating = 0;
+	c->tags = 0;
+	for (i = 0; i < NRULE; i++)
+		if (rulematch(set[i].class, p->class)
+		&& rulematch(set[i].instance, p->instance)
+		&& rulematch(set[i].title, c->name))
+		{
+			c->isfloating = set[i].isfloating;
+			c->tags |= set[i].tags;
+		}
+}
+
+static void
+bench(const char *what, void (*fn)(Client *, Props *), int known)
+{
+	static Props p;
+	Client c;
+	double t0;
+	int i;
+
+	memset(&c, 0, sizeof(c));
+	c.name = "~ - vim";
+	t0 = now();
+	for (i = 0; i < RUNS; i++) {
+		snprintf(p.class, sizeof(p.class), known ? "class%d" : "other%d", i % (NRULE - NGLOB));
+		fn(&c, &p);
+	}
+	printf("%-10s %-14s %8.0f ns/window\n", what,
+		known ? "known class" : "unknown class", (now() - t0) / RUNS);
+}
+
+int
+main(void)
+{
+	static Monitor m;
+	int i;
+
+	mons = &m;
+	m.num = -1;
+	for (i = 0; i < NRULE; i++) {
+		if (i < NRULE - NGLOB)
+			snprintf(names[i], sizeof(names[i]), "class%d", i);
+		else
+			snprintf(names[i], sizeof(names[i]), "glob%d*", i);
+		set[i].class = names[i];
+		set[i].tags = 1 << i % 9;
+		set[i].isfloating = i % 2;
+		set[i].monitor = -1;
+	}
+	compilerules(set, NRULE);
+	printf("%d rules, %d of them glob patterns\n", NRULE, NGLOB);
+	bench("compiled", applyrules, 1);
+	bench("compiled", applyrules, 0);
+	bench("scan", scanrules, 1);
+	bench("scan", scanrules, 0);
+	return 0;
+}
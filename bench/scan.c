@@ -0,0 +1,136 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Times how long dwm takes to adopt the windows that exist when it starts,
+ * on a private Xvfb with n synthetic mapped windows, every one with a title
+ * and class, every fourth one with size hints and every tenth one transient
+ * for the window before it. Start up counts from the fork of dwm to its
+ * first ipc reply, which it gives only after scan(); the requests are the
+ * ones get_stats counts by then. Runs ./dwm and, if it has been built,
+ * ./dwm-xcb, with no windows and with n.
+ *
+ * usage: bench/scan [-n windows] [-i runs] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "../test/xenv.h"
+
+#define SKIP 77 /* exit status of a run that cannot happen here, see test/test.h */
+
+static Display *dpy;
+static int nwins = 500, runs = 5;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+create(int n)
+{
+	XClassHint class = { "scan", "Scan" };
+	XSizeHints *size;
+	Window w, prev = None;
+	char title[64];
+	int i;
+
+	for (i = 0; i < n; i++) {
+		w = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), i % 64 * 10,
+			i % 48 * 10, 400, 300, 0, 0, 0);
+		snprintf(title, sizeof(title), "window %d of %d", i, n);
+		XStoreName(dpy, w, title);
+		XSetClassHint(dpy, w, &class);
+		if (i % 4 == 0 && (size = XAllocSizeHints())) {
+			size->flags = PMinSize|PBaseSize|PResizeInc;
+			size->min_width = 16;
+			size->min_height = 32;
+			size->base_width = size->base_height = 2;
+			size->width_inc = 7;
+			size->height_inc = 15;
+			XSetWMNormalHints(dpy, w, size);
+			XFree(size);
+		}
+		if (i % 10 == 9)
+			XSetTransientForHint(dpy, w, prev);
+		XMapWindow(dpy, w);
+		prev = w;
+	}
+	XSync(dpy, False);
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* starts and stops wm runs times, prints the median start up */
+static int
+bench(char *wm, int n)
+{
+	char buf[1024];
+	double t0, *t;
+	long requests = 0;
+	int i;
+
+	if (!(t = calloc(runs, sizeof(double))))
+		return 0;
+	for (i = 0; i < runs; i++) {
+		t0 = now();
+		if (!xenv_wm((char *[]){ wm, NULL })
+		|| xenv_ipc("get_stats", buf, sizeof(buf)) < 0) {
+			xenv_wmstop();
+			free(t);
+			return 0;
+		}
+		t[i] = now() - t0;
+		requests += xenv_statof(buf, "x", "requests");
+		xenv_wmstop();
+	}
+	qsort(t, runs, sizeof(double), cmp);
+	printf("%-10s %8d %12.0f %12.0f %12ld\n", wm, n, t[runs / 2], t[runs - 1],
+		requests / runs);
+	free(t);
+	return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static char *wms[] = { "./dwm", "./dwm-xcb" };
+	int i, w;
+
+	for (i = 1; i + 1 < argc; i += 2)
+		if (!strcmp(argv[i], "-n"))
+			nwins = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "-i"))
+			runs = atoi(argv[i + 1]);
+		else {
+			fprintf(stderr, "usage: bench/scan [-n windows] [-i runs]\n");
+			return 1;
+		}
+	if (nwins < 1 || runs < 1)
+		return 1;
+	if (!(dpy = xenv_server()))
+		return SKIP;
+	printf("%-10s %8s %12s %12s %12s\n", "wm", "windows", "p50 us", "max us", "requests");
+	for (w = 0; w < 2; w++)
+		if (!bench(wms[w], 0) && w == 0) {
+			xenv_stop();
+			return 1;
+		}
+	create(nwins);
+	for (w = 0; w < 2; w++)
+		bench(wms[w], nwins);
+	xenv_stop();
+	return 0;
+}
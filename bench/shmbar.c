@@ -0,0 +1,126 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Compares the two ways of drawing the bar, Xft on the server and the
+ * client-side MIT-SHM surfaces of setshmbar, on a private Xvfb. A client
+ * changes its title and the root window its status n times in each mode;
+ * an update has been drawn once dwm answers an ipc request after handling
+ * its PropertyNotify. Prints the latency percentiles and the X requests
+ * dwm sent per update, as counted by get_stats. setshmbar falls back to
+ * Xft when the server has no MIT-SHM, both modes then draw the same.
+ *
+ * usage: bench/shmbar [-i updates] [-t title length] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <X11/Xlib.h>
+
+#include "../test/xenv.h"
+
+#define SKIP 77 /* exit status of a run that cannot happen here, see test/test.h */
+
+static Display *dpy;
+static int nupdates = 500, titlelen = 60;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* waits until dwm has nothing left of what was sent so far, leaves its
+ * last get_stats reply in buf */
+static void
+quiesce(char *buf, size_t size)
+{
+	long events = -1;
+
+	XSync(dpy, False);
+	for (;;) {
+		xenv_ipc("get_stats", buf, size);
+		if (xenv_statof(buf, "x", "events") == events)
+			return;
+		events = xenv_statof(buf, "x", "events");
+		xenv_sleep(1000);
+	}
+}
+
+static void
+bench(const char *mode, const char *what, Window w, double *lat)
+{
+	char buf[1024], text[256];
+	long events, requests, total = 0;
+	double t0;
+	int i, len;
+
+	for (i = 0; i < nupdates; i++) {
+		quiesce(buf, sizeof(buf));
+		events = xenv_statof(buf, "x", "events");
+		requests = xenv_statof(buf, "x", "requests");
+		len = snprintf(text, sizeof(text), "%s %d ", what, i);
+		for (; len < titlelen && len < (int)sizeof(text) - 1; len++)
+			text[len] = 'a' + len % 26;
+		text[len] = '\0';
+		t0 = now();
+		XStoreName(dpy, w, text);
+		XFlush(dpy);
+		/* dwm answers ipc only between event batches */
+		do
+			xenv_ipc("get_stats", buf, sizeof(buf));
+		while (xenv_statof(buf, "x", "events") <= events && now() - t0 < 2e6);
+		lat[i] = now() - t0;
+		quiesce(buf, sizeof(buf));
+		total += xenv_statof(buf, "x", "requests") - requests;
+	}
+	qsort(lat, nupdates, sizeof(double), cmp);
+	printf("%-6s %-8s %8.0f %8.0f %8.0f %10.1f\n", mode, what,
+		lat[nupdates / 2], lat[(int)(0.9 * (nupdates - 1))], lat[nupdates - 1],
+		(double)total / nupdates);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const char *modes[] = { "xft", "shm" };
+	char buf[256];
+	double *lat;
+	Window c;
+	int i;
+
+	for (i = 1; i + 1 < argc; i += 2)
+		if (!strcmp(argv[i], "-i"))
+			nupdates = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "-t"))
+			titlelen = atoi(argv[i + 1]);
+		else {
+			fprintf(stderr, "usage: bench/shmbar [-i updates] [-t titlelen]\n");
+			return 1;
+		}
+	if (nupdates < 1 || !(lat = calloc(nupdates, sizeof(double))))
+		return 1;
+	if (!(dpy = xenv_start()))
+		return SKIP;
+	c = xenv_client("shmbar", 400, 300);
+	printf("%-6s %-8s %8s %8s %8s %10s\n", "mode", "update", "p50 us", "p90 us",
+		"max us", "requests");
+	for (i = 0; i < 2; i++) {
+		snprintf(buf, sizeof(buf), "setshmbar %d", i);
+		xenv_ipc(buf, buf, sizeof(buf));
+		bench(modes[i], "title", c, lat);
+		bench(modes[i], "status", DefaultRootWindow(dpy), lat);
+	}
+	xenv_stop();
+	free(lat);
+	return 0;
+}
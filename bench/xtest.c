@@ -0,0 +1,225 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Measures how long dwm takes to settle after view, focusstack, setmfact
+ * and zoom key bindings, pressed through XTest on a private Xvfb, with n
+ * synthetic clients spread over the tags that keep changing their titles.
+ * An action has settled once dwm answers an ipc request after handling
+ * its key press. Prints latency percentiles and the X requests dwm sent
+ * per action, as counted by get_stats.
+ *
+ * usage: bench/xtest [-n clients] [-i actions] [-r title updates per
+ *        client and second] [-t title length] [-h every nth client has
+ *        terminal size hints, 0 none] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+#include "../test/xenv.h"
+
+#define NTAGS 9
+#define SKIP  77 /* exit status of a run that cannot happen here, see test/test.h */
+
+enum { ActView, ActFocus, ActMfact, ActZoom, ActLast };
+
+typedef struct {
+	const char *name;
+	double *lat;          /* microseconds */
+	int n;
+	long requests;
+} Action;
+
+static Action actions[ActLast] = {
+	{ "view" }, { "focusstack" }, { "setmfact" }, { "zoom" },
+};
+static Display *dpy;
+static Window *wins;
+static int nwins = 50, nactions = 400, titlelen = 40, hintsevery = 3;
+static double rate = 5;
+static KeyCode super;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+settitle(int i, unsigned long gen)
+{
+	char title[256];
+	int len;
+
+	len = snprintf(title, sizeof(title), "client %d update %lu ", i, gen);
+	for (; len < titlelen && len < (int)sizeof(title) - 1; len++)
+		title[len] = 'a' + len % 26;
+	title[len] = '\0';
+	XStoreName(dpy, wins[i], title);
+}
+
+static Window
+spawn(int i)
+{
+	XSizeHints *size;
+	Window w;
+
+	w = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 400, 300, 0, 0, 0);
+	wins[i] = w;
+	settitle(i, 0);
+	if (hintsevery && i % hintsevery == 0 && (size = XAllocSizeHints())) {
+		size->flags = PMinSize|PBaseSize|PResizeInc;
+		size->min_width = 16;
+		size->min_height = 32;
+		size->base_width = size->base_height = 2;
+		size->width_inc = 7;
+		size->height_inc = 15;
+		XSetWMNormalHints(dpy, w, size);
+		XFree(size);
+	}
+	XMapWindow(dpy, w);
+	if (!xenv_managed(w))
+		fprintf(stderr, "xtest: client %d was not managed\n", i);
+	return w;
+}
+
+/* waits until dwm has nothing left of what was sent so far, leaves its
+ * last get_stats reply in buf */
+static void
+quiesce(char *buf, size_t size)
+{
+	long events = -1;
+
+	XSync(dpy, False);
+	for (;;) {
+		xenv_ipc("get_stats", buf, size);
+		if (xenv_statof(buf, "x", "events") == events)
+			return;
+		events = xenv_statof(buf, "x", "events");
+		xenv_sleep(1000);
+	}
+}
+
+static void
+press(KeySym sym)
+{
+	KeyCode k = XKeysymToKeycode(dpy, sym);
+
+	XTestFakeKeyEvent(dpy, super, True, CurrentTime);
+	XTestFakeKeyEvent(dpy, k, True, CurrentTime);
+	XTestFakeKeyEvent(dpy, k, False, CurrentTime);
+	XTestFakeKeyEvent(dpy, super, False, CurrentTime);
+	XFlush(dpy);
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double
+pct(const Action *a, double p)
+{
+	return a->n ? a->lat[(int)(p * (a->n - 1) + 0.5)] : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const KeySym tagkeys[NTAGS] = { XK_1, XK_2, XK_3, XK_4, XK_5, XK_6, XK_7, XK_8, XK_9 };
+	char buf[1024];
+	int i, ev, err, major, minor, next = 0;
+	long events, requests;
+	unsigned long gen = 0;
+	double t0, tnext, dt;
+	Action *a;
+	KeySym sym;
+
+	for (i = 1; i + 1 < argc; i += 2)
+		if (!strcmp(argv[i], "-n"))
+			nwins = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "-i"))
+			nactions = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "-r"))
+			rate = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "-t"))
+			titlelen = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "-h"))
+			hintsevery = atoi(argv[i + 1]);
+		else {
+			fprintf(stderr, "usage: bench/xtest [-n clients] [-i actions] "
+				"[-r rate] [-t titlelen] [-h hintsevery]\n");
+			return 1;
+		}
+	if (nwins < 1 || nactions < 1)
+		return 1;
+	if (!(dpy = xenv_start()))
+		return SKIP;
+	if (!XTestQueryExtension(dpy, &ev, &err, &major, &minor)) {
+		fprintf(stderr, "xtest: the server has no XTEST\n");
+		xenv_stop();
+		return SKIP;
+	}
+	super = XKeysymToKeycode(dpy, XK_Super_L);
+	wins = calloc(nwins, sizeof(Window));
+	for (i = 0; i < ActLast; i++)
+		actions[i].lat = calloc(nactions, sizeof(double));
+	/* spread the clients over the tags, a view always finds some */
+	for (i = 0; i < nwins; i++) {
+		snprintf(buf, sizeof(buf), "view %u", 1u << i % NTAGS);
+		xenv_ipc(buf, buf, sizeof(buf));
+		spawn(i);
+	}
+	srand(1);
+	tnext = now();
+	for (i = 0; i < nactions; i++) {
+		/* the title updates due by now, round robin */
+		for (t0 = now(); rate > 0 && tnext <= t0; tnext += 1e6 / (rate * nwins)) {
+			settitle(next, ++gen);
+			next = (next + 1) % nwins;
+		}
+		quiesce(buf, sizeof(buf));
+		events = xenv_statof(buf, "x", "events");
+		requests = xenv_statof(buf, "x", "requests");
+		a = &actions[rand() % ActLast];
+		switch (a - actions) {
+		case ActView:  sym = tagkeys[rand() % NTAGS]; break;
+		case ActFocus: sym = rand() % 2 ? XK_j : XK_k; break;
+		case ActMfact: sym = rand() % 2 ? XK_h : XK_l; break;
+		default:       sym = XK_Return; break;
+		}
+		t0 = now();
+		press(sym);
+		/* dwm answers ipc only between event batches */
+		do
+			xenv_ipc("get_stats", buf, sizeof(buf));
+		while (xenv_statof(buf, "x", "events") <= events && now() - t0 < 2e6);
+		if ((dt = now() - t0) >= 2e6)
+			fprintf(stderr, "xtest: %s key was not handled within 2 s\n", a->name);
+		a->lat[a->n++] = dt;
+		quiesce(buf, sizeof(buf));
+		a->requests += xenv_statof(buf, "x", "requests") - requests;
+	}
+	printf("%d clients, title updates %.1f/s each, every %d with size hints\n",
+		nwins, rate, hintsevery);
+	printf("%-12s %6s %10s %10s %10s %10s %10s\n", "action", "n",
+		"p50 us", "p90 us", "p99 us", "max us", "requests");
+	for (i = 0; i < ActLast; i++) {
+		a = &actions[i];
+		qsort(a->lat, a->n, sizeof(double), cmp);
+		printf("%-12s %6d %10.0f %10.0f %10.0f %10.0f %10.1f\n", a->name, a->n,
+			pct(a, 0.5), pct(a, 0.9), pct(a, 0.99), pct(a, 1),
+			a->n ? (double)a->requests / a->n : 0);
+	}
+	xenv_stop();
+	return 0;
+}
@@ -4,10 +4,12 @@
 static const unsigned int borderpx  = 2;        /* border pixel of windows */
 static const Gap default_gap        = {.isgap = 1, .realgap = 10, .gappx = 10};
 static const unsigned int snap      = 32;       /* snap pixel */
+static const unsigned int dragrate  = 60;       /* move/resize steps per second where the refresh rate is unknown */
 static const int showbar            = 1;        /* 0 means no bar */
 static const int topbar             = 1;        /* 0 means bottom bar */
 static const int horizpadbar        = 0;        /* horizontal padding for statusbar */
 static const int vertpadbar         = 8;        /* vertical padding for statusbar */
+static const int shmbar             = 0;        /* 1 means draw bars client-side in shared memory, if available, see setshmbar */
 static const int vertpad            = 10;       /* vertical padding of bar */
 static const int sidepad            = 10;       /* horizontal padding of bar */
 static const char* fonts[]          = { "Ubuntu Mono:size=12" };
@@ -26,17 +28,36 @@ static const char *colors[][3]      = {
 /* tagging */
 static const char* tags[] = { "1", "2", "3", "4", "5", "6", "7", "8", "9" };
 
+static const Rule rules[] = {
+	/* xprop(1):
+	 *	WM_CLASS(STRING) = instance, class
+	 *	WM_NAME(STRING) = title
+	 *	_NET_WM_WINDOW_TYPE(ATOM) = wintype
+	 * class, instance and title match exactly or as a glob(7) pattern,
+	 * NULL matches anything; rules with an exact class are found by hash.
+	 * Only the first 63 bytes of a window's class and instance are kept,
+	 * a rule for a longer one names those 63 or is a pattern like "Foo*"
+	 */
+	/* class      instance    title       wintype   tags mask     isfloating   monitor */
+	{ "Gimp",     NULL,       NULL,       NULL,     0,            1,           -1 },
+	{ "Firefox",  NULL,       NULL,       NULL,     1 << 8,       0,           -1 },
+};
+
 /* layout(s) */
 static const float mfact     = 0.55; /* factor of master area size [0.05..0.95] */
 static const int nmaster     = 1;    /* number of clients in master area */
 static const int resizehints = 1;    /* 1 means respect size hints in tiled resizals */
 static const int lockfullscreen = 1; /* 1 will force focus on the fullscreen window */
+static const int unmaphidden = 0;    /* 1 means unmap clients of hidden tags, which stops them redrawing, instead of moving them off screen */
 
 static const Layout layouts[] = {
 	/* symbol     arrange function */
 	{ "[]=",      tile },    /* first entry is default */
 	{ "><>",      NULL },    /* no layout function means floating behavior */
 	{ "[M]",      monocle },
+	{ "###",      grid },
+	{ "D",        deck },
+	{ "|M|",      centeredmaster },
 };
 
 /* key definitions */
@@ -79,6 +100,9 @@ static Key keys[] = {
 	{ MODKEY,                       XK_t,                      setlayout,      {.v = &layouts[0]} },
 	{ MODKEY,                       XK_f,                      setlayout,      {.v = &layouts[1]} },
 	{ MODKEY,                       XK_m,                      setlayout,      {.v = &layouts[2]} },
+	{ MODKEY,                       XK_g,                      setlayout,      {.v = &layouts[3]} },
+	{ MODKEY|ShiftMask,             XK_m,                      setlayout,      {.v = &layouts[4]} },
+	{ MODKEY,                       XK_c,                      setlayout,      {.v = &layouts[5]} },
 	{ MODKEY,                       XK_space,                  setlayout,      {0} },
 	{ MODKEY|ShiftMask,             XK_space,                  togglefloating, {0} },
 	{ MODKEY,                       XK_0,                      view,           {.ui = ~0 } },
@@ -128,3 +152,30 @@ static Button buttons[] = {
 	{ ClkTagBar,            MODKEY,         Button3,        toggletag,      {0} },
 };
 
+/* ipc */
+static const char* ipcsockpath = ""; /* "" is $XDG_RUNTIME_DIR/dwm-$DISPLAY.sock, NULL disables the ipc socket */
+
+/* ipc commands, "get_state" is built in */
+static const IpcCommand ipccommands[] = {
+	/* name               function        argument type */
+	{ "view",             view,           IpcArgUint },
+	{ "toggleview",       toggleview,     IpcArgUint },
+	{ "tag",              tag,            IpcArgUint },
+	{ "toggletag",        toggletag,      IpcArgUint },
+	{ "shiftview",        shiftview,      IpcArgInt },
+	{ "focusstack",       focusstack,     IpcArgInt },
+	{ "pushup",           pushup,         IpcArgNone },
+	{ "pushdown",         pushdown,       IpcArgNone },
+	{ "zoom",             zoom,           IpcArgNone },
+	{ "incnmaster",       incnmaster,     IpcArgInt },
+	{ "setmfact",         setmfact,       IpcArgFloat },
+	{ "setlayout",        setlayout,      IpcArgLayout },
+	{ "setgaps",          setgaps,        IpcArgInt },
+	{ "togglebar",        togglebar,      IpcArgNone },
+	{ "setshmbar",        setshmbar,      IpcArgInt },
+	{ "togglefloating",   togglefloating, IpcArgNone },
+	{ "killclient",       killclient,     IpcArgNone },
+	{ "focusmon",         focusmon,       IpcArgInt },
+	{ "tagmon",           tagmon,         IpcArgInt },
+	{ "quit",             quit,           IpcArgNone },
+};
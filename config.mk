@@ -14,6 +14,30 @@ X11LIB = /usr/X11R6/lib
 XINERAMALIBS  = -lXinerama
 XINERAMAFLAGS = -DXINERAMA
 
+# RandR 1.5, monitors tracked by output name, uncomment if you want it
+# (needs the libXrandr headers)
+#XRANDRLIBS  = -lXrandr
+#XRANDRFLAGS = -DXRANDR
+
+# XCB, pipelined adoption of existing windows in scan(), uncomment if you want it
+# (needs the libX11-xcb and libxcb headers)
+#XCBLIBS  = -lX11-xcb -lxcb
+#XCBFLAGS = -DXCB
+
+# MIT-SHM, bars drawn client-side into shared memory, comment if you don't want it
+SHMLIBS  = -lXext -lfreetype
+SHMFLAGS = -DXSHM
+
+# XSync, resizes paced by _NET_WM_SYNC_REQUEST clients, comment if you don't want it
+XSYNCLIBS  = -lXext
+XSYNCFLAGS = -DXSYNC
+
+# XTest, for the key presses of bench/xtest only
+XTESTLIBS = -lXtst
+
+# event loop statistics, dumped to stderr on SIGUSR2, uncomment if you want them
+#EVSTATSFLAGS = -DEVSTATS
+
 # freetype
 FREETYPELIBS = -lfontconfig -lXft
 FREETYPEINC = /usr/include/freetype2
@@ -22,10 +46,10 @@ FREETYPEINC = /usr/include/freetype2
 
 # includes and libs
 INCS = -I${X11INC} -I${FREETYPEINC}
-LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS}
+LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${XRANDRLIBS} ${XCBLIBS} ${XSYNCLIBS} ${SHMLIBS} ${FREETYPELIBS}
 
 # flags
-CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_POSIX_C_SOURCE=200809L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS}
+CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_POSIX_C_SOURCE=200809L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS} ${XRANDRFLAGS} ${XCBFLAGS} ${XSYNCFLAGS} ${SHMFLAGS} ${EVSTATSFLAGS}
 #CFLAGS   = -g -std=c99 -pedantic -Wall -O0 ${INCS} ${CPPFLAGS}
 CFLAGS   = -std=c99 -Wall -Wno-deprecated-declarations -Os ${INCS} ${CPPFLAGS}
 LDFLAGS  = ${LIBS}
@@ -1,15 +1,46 @@
 /* See LICENSE file for copyright and license details. */
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <X11/Xlib.h>
 #include <X11/Xft/Xft.h>
+#ifdef XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_LCD_FILTER_H
+#endif /* XSHM */
 
 #include "drw.h"
 #include "util.h"
 
 #define UTF_INVALID 0xFFFD
 #define UTF_SIZ     4
+#define GLYPHCACHE  256
+
+#ifdef XSHM
+typedef struct {
+	FT_UInt index;
+	int left, top, advance;
+	unsigned int w, h;
+	unsigned char *alpha;   /* coverage of red, green and blue, w * h * 3 */
+} Gly;
+
+/* the glyphs of a font and how FreeType renders them, see glyphs_create() */
+typedef struct {
+	FT_Int32 load;
+	FT_Render_Mode mode;
+	FT_LcdFilter filter;
+	int bgr;                /* subpixels in blue, green, red order */
+	Gly *slot[GLYPHCACHE];
+} Glyphs;
+
+static int shmfailed, shmopcode;
+static int (*shmxerror)(Display *, XErrorEvent *);
+#endif /* XSHM */
 
 static const unsigned char utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const unsigned char utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
@@ -70,7 +101,9 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->root = root;
 	drw->w = w;
 	drw->h = h;
-	drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
+	if (w && h)
+		drw->pixmap = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
+	drw->drawable = drw->pixmap;
 	drw->gc = XCreateGC(dpy, root, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
 
@@ -85,20 +118,351 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 
 	drw->w = w;
 	drw->h = h;
-	if (drw->drawable)
-		XFreePixmap(drw->dpy, drw->drawable);
-	drw->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+	if (drw->pixmap)
+		XFreePixmap(drw->dpy, drw->pixmap);
+	drw->pixmap = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+	drw->drawable = drw->pixmap;
 }
 
 void
 drw_free(Drw *drw)
 {
-	XFreePixmap(drw->dpy, drw->drawable);
+	if (drw->pixmap)
+		XFreePixmap(drw->dpy, drw->pixmap);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
 	free(drw);
 }
 
+/* Draws on s, which stays owned by the caller, from now on. NULL selects
+ * the own pixmap again. */
+void
+drw_select(Drw *drw, Surf *s)
+{
+	if (!drw)
+		return;
+
+	drw->surf = s;
+	drw->drawable = s ? s->pixmap : drw->pixmap;
+	if (s) {
+		drw->w = s->w;
+		drw->h = s->h;
+	}
+}
+
+#ifdef XSHM
+/* Notes a failed MIT-SHM request, other errors go to the previous handler. */
+static int
+shmerror(Display *dpy, XErrorEvent *ee)
+{
+	if (ee->request_code != shmopcode)
+		return shmxerror(dpy, ee);
+	shmfailed = 1;
+	return 0;
+}
+
+static void
+surf_shm_free(Drw *drw, Surf *s)
+{
+	XShmSegmentInfo *info = s->shminfo;
+
+	if (info->shmaddr && info->shmaddr != (char *)-1) {
+		if (!shmfailed)
+			XShmDetach(drw->dpy, info);
+		shmdt(info->shmaddr);
+	}
+	if (s->image) {
+		s->image->data = NULL;
+		XDestroyImage(s->image);
+		s->image = NULL;
+	}
+	free(info);
+	s->shminfo = NULL;
+}
+
+static int
+surf_shm_create(Drw *drw, Surf *s)
+{
+	XShmSegmentInfo *info;
+	int one = 1;
+
+	s->shminfo = info = ecalloc(1, sizeof(XShmSegmentInfo));
+	shmfailed = 1;
+	s->image = XShmCreateImage(drw->dpy, DefaultVisual(drw->dpy, drw->screen),
+		DefaultDepth(drw->dpy, drw->screen), ZPixmap, NULL, info, s->w, s->h);
+	/* pixels are written as native 32 bit words */
+	if (!s->image || s->image->bits_per_pixel != 32
+	|| s->image->byte_order != (*(char *)&one ? LSBFirst : MSBFirst)
+	|| (info->shmid = shmget(IPC_PRIVATE, s->image->bytes_per_line * s->h,
+	                         IPC_CREAT | 0600)) == -1) {
+		surf_shm_free(drw, s);
+		return 0;
+	}
+	info->shmaddr = s->image->data = shmat(info->shmid, NULL, 0);
+	shmctl(info->shmid, IPC_RMID, NULL); /* gone once detached on both sides */
+	if (info->shmaddr == (char *)-1) {
+		surf_shm_free(drw, s);
+		return 0;
+	}
+	info->readOnly = False;
+	/* attaching fails on remote displays */
+	shmfailed = 0;
+	shmxerror = XSetErrorHandler(shmerror);
+	XShmAttach(drw->dpy, info);
+	XSync(drw->dpy, False);
+	XSetErrorHandler(shmxerror);
+	if (shmfailed) {
+		surf_shm_free(drw, s);
+		return 0;
+	}
+	return 1;
+}
+
+/* Waits until the server has copied the image of s to the window before
+ * it is drawn over. Usually events have shown it is past the put already. */
+static void
+surf_wait(Drw *drw, Surf *s)
+{
+	if (s->put && (long)(LastKnownRequestProcessed(drw->dpy) - s->put) < 0)
+		XSync(drw->dpy, False);
+	s->put = 0;
+}
+
+static void
+surf_fill(Surf *s, int x, int y, unsigned int w, unsigned int h, unsigned long pixel)
+{
+	int i, x1 = MIN(x + (int)w, (int)s->w), y1 = MIN(y + (int)h, (int)s->h);
+	uint32_t *row;
+
+	x = MAX(x, 0);
+	y = MAX(y, 0);
+	if (x >= x1 || y >= y1)
+		return;
+	row = (uint32_t *)(s->image->data + y * s->image->bytes_per_line) + x;
+	for (i = 0; i < x1 - x; i++)
+		row[i] = pixel;
+	/* further rows are copies, memcpy does them in vector-sized chunks */
+	for (i = y + 1; i < y1; i++)
+		memcpy(s->image->data + i * s->image->bytes_per_line + x * 4, row, (x1 - x) * 4);
+}
+
+/* Derives how FreeType renders the glyphs of xfont from its fontconfig
+ * pattern, the way Xft does, so both paths draw the same text. */
+static Glyphs *
+glyphs_create(XftFont *xfont)
+{
+	FcPattern *p = xfont->pattern;
+	FcBool aa, hinting, autohint, bitmap;
+	int style, rgba, filter;
+	Glyphs *gs = ecalloc(1, sizeof(Glyphs));
+
+	if (FcPatternGetBool(p, FC_ANTIALIAS, 0, &aa) != FcResultMatch)
+		aa = FcTrue;
+	if (FcPatternGetBool(p, FC_HINTING, 0, &hinting) != FcResultMatch)
+		hinting = FcTrue;
+	if (FcPatternGetInteger(p, FC_HINT_STYLE, 0, &style) != FcResultMatch)
+		style = FC_HINT_FULL;
+	if (FcPatternGetBool(p, FC_AUTOHINT, 0, &autohint) != FcResultMatch)
+		autohint = FcFalse;
+	if (FcPatternGetBool(p, FC_EMBEDDED_BITMAP, 0, &bitmap) != FcResultMatch)
+		bitmap = FcTrue;
+	if (FcPatternGetInteger(p, FC_RGBA, 0, &rgba) != FcResultMatch)
+		rgba = FC_RGBA_UNKNOWN;
+	if (FcPatternGetInteger(p, FC_LCD_FILTER, 0, &filter) != FcResultMatch)
+		filter = FC_LCD_DEFAULT;
+
+	gs->load = FT_LOAD_DEFAULT;
+	if (aa && !bitmap)
+		gs->load |= FT_LOAD_NO_BITMAP;
+	if (!hinting || style == FC_HINT_NONE)
+		gs->load |= FT_LOAD_NO_HINTING;
+	if (autohint)
+		gs->load |= FT_LOAD_FORCE_AUTOHINT;
+	gs->mode = FT_RENDER_MODE_NORMAL;
+	if (!aa) {
+		gs->load |= FT_LOAD_TARGET_MONO;
+		gs->mode = FT_RENDER_MODE_MONO;
+	} else if (rgba == FC_RGBA_RGB || rgba == FC_RGBA_BGR) {
+		gs->mode = FT_RENDER_MODE_LCD;
+		if (!(gs->load & FT_LOAD_NO_HINTING))
+			gs->load |= style == FC_HINT_SLIGHT ? FT_LOAD_TARGET_LIGHT : FT_LOAD_TARGET_LCD;
+	} else if (rgba == FC_RGBA_VRGB || rgba == FC_RGBA_VBGR) {
+		gs->mode = FT_RENDER_MODE_LCD_V;
+		if (!(gs->load & FT_LOAD_NO_HINTING))
+			gs->load |= style == FC_HINT_SLIGHT ? FT_LOAD_TARGET_LIGHT : FT_LOAD_TARGET_LCD_V;
+	} else if (!(gs->load & FT_LOAD_NO_HINTING) && style == FC_HINT_SLIGHT)
+		gs->load |= FT_LOAD_TARGET_LIGHT;
+	gs->bgr = rgba == FC_RGBA_BGR || rgba == FC_RGBA_VBGR;
+	switch (filter) {
+	case FC_LCD_NONE:   gs->filter = FT_LCD_FILTER_NONE; break;
+	case FC_LCD_LIGHT:  gs->filter = FT_LCD_FILTER_LIGHT; break;
+	case FC_LCD_LEGACY: gs->filter = FT_LCD_FILTER_LEGACY; break;
+	default:            gs->filter = FT_LCD_FILTER_DEFAULT; break;
+	}
+	return gs;
+}
+
+static Gly *
+glyph_get(Drw *drw, Fnt *font, FT_UInt index)
+{
+	Glyphs *gs;
+	Gly *g;
+	FT_Face face;
+	FT_Bitmap *bm;
+	XGlyphInfo ext;
+	unsigned char *a;
+	unsigned int i, j, k;
+
+	if (!font->glyphs)
+		font->glyphs = glyphs_create(font->xfont);
+	gs = font->glyphs;
+	if ((g = gs->slot[index % GLYPHCACHE]) && g->index == index)
+		return g;
+	if (!(face = XftLockFace(font->xfont)))
+		return NULL;
+	if (gs->mode == FT_RENDER_MODE_LCD || gs->mode == FT_RENDER_MODE_LCD_V)
+		FT_Library_SetLcdFilter(face->glyph->library, gs->filter);
+	if (FT_Load_Glyph(face, index, gs->load)
+	|| FT_Render_Glyph(face->glyph, gs->mode)) {
+		XftUnlockFace(font->xfont);
+		return NULL;
+	}
+	if (!g)
+		g = gs->slot[index % GLYPHCACHE] = ecalloc(1, sizeof(Gly));
+	free(g->alpha);
+	bm = &face->glyph->bitmap;
+	g->index = index;
+	g->left = face->glyph->bitmap_left;
+	g->top = face->glyph->bitmap_top;
+	g->w = g->h = 0;
+	switch (bm->pixel_mode) {
+	case FT_PIXEL_MODE_GRAY:
+	case FT_PIXEL_MODE_MONO:
+		g->w = bm->width;
+		g->h = bm->rows;
+		break;
+	case FT_PIXEL_MODE_LCD:
+		g->w = bm->width / 3;
+		g->h = bm->rows;
+		break;
+	case FT_PIXEL_MODE_LCD_V:
+		g->w = bm->width;
+		g->h = bm->rows / 3;
+		break;
+	}
+	g->alpha = ecalloc(g->w * g->h * 3 + 1, 1);
+	for (j = 0; j < g->h; j++)
+		for (i = 0; i < g->w; i++)
+			for (a = &g->alpha[(j * g->w + i) * 3], k = 0; k < 3; k++)
+				switch (bm->pixel_mode) {
+				case FT_PIXEL_MODE_GRAY:
+					a[k] = bm->buffer[j * bm->pitch + i];
+					break;
+				case FT_PIXEL_MODE_MONO:
+					a[k] = bm->buffer[j * bm->pitch + i / 8] & (0x80 >> i % 8) ? 255 : 0;
+					break;
+				case FT_PIXEL_MODE_LCD:
+					a[gs->bgr ? 2 - k : k] = bm->buffer[j * bm->pitch + i * 3 + k];
+					break;
+				case FT_PIXEL_MODE_LCD_V:
+					a[gs->bgr ? 2 - k : k] = bm->buffer[(j * 3 + k) * bm->pitch + i];
+					break;
+				}
+	XftUnlockFace(font->xfont);
+	/* advance as Xft measures it, so widths agree with drw_font_getexts */
+	XftGlyphExtents(drw->dpy, font->xfont, &index, 1, &ext);
+	g->advance = ext.xOff;
+	return g;
+}
+
+/* Composites the glyphs of the UTF-8 string onto the image of s. */
+static void
+surf_string(Drw *drw, Surf *s, Fnt *font, XftColor *col, int x, int y, const char *text, size_t len)
+{
+	unsigned int fr = col->color.red >> 8, fg = col->color.green >> 8, fb = col->color.blue >> 8;
+	unsigned int i, j, d;
+	unsigned char *a;
+	int gx, gy;
+	size_t n;
+	long u;
+	uint32_t *p;
+	Gly *g;
+
+	surf_wait(drw, s);
+	for (; len; text += n, len -= n) {
+		if (!(n = utf8decode(text, &u, MIN(len, UTF_SIZ))))
+			break;
+		if (!(g = glyph_get(drw, font, XftCharIndex(drw->dpy, font->xfont, u))))
+			continue;
+		for (j = 0; j < g->h; j++) {
+			if ((gy = y - g->top + (int)j) < 0 || gy >= (int)s->h)
+				continue;
+			p = (uint32_t *)(s->image->data + gy * s->image->bytes_per_line);
+			for (i = 0; i < g->w; i++) {
+				gx = x + g->left + (int)i;
+				a = &g->alpha[(j * g->w + i) * 3];
+				if (gx < 0 || gx >= (int)s->w || !(a[0] | a[1] | a[2]))
+					continue;
+				d = p[gx];
+				p[gx] = ((fr * a[0] + (d >> 16 & 0xff) * (255 - a[0])) / 255) << 16
+				      | ((fg * a[1] + (d >> 8 & 0xff) * (255 - a[1])) / 255) << 8
+				      | ((fb * a[2] + (d & 0xff) * (255 - a[2])) / 255);
+			}
+		}
+		x += g->advance;
+	}
+}
+#endif /* XSHM */
+
+/* Lets drw_surf_create draw client-side into shared memory images, if the
+ * server supports it and uses 8 bit per channel TrueColor. */
+int
+drw_shm_enable(Drw *drw)
+{
+#ifdef XSHM
+	Visual *v = DefaultVisual(drw->dpy, drw->screen);
+	int ev, err;
+
+	drw->shm = XQueryExtension(drw->dpy, "MIT-SHM", &shmopcode, &ev, &err)
+		&& XShmQueryExtension(drw->dpy)
+		&& DefaultDepth(drw->dpy, drw->screen) == 24 && v->class == TrueColor
+		&& v->red_mask == 0xff0000 && v->green_mask == 0xff00 && v->blue_mask == 0xff;
+#endif /* XSHM */
+	return drw->shm;
+}
+
+Surf *
+drw_surf_create(Drw *drw, unsigned int w, unsigned int h)
+{
+	Surf *s = ecalloc(1, sizeof(Surf));
+
+	s->w = w;
+	s->h = h;
+#ifdef XSHM
+	if (drw->shm && surf_shm_create(drw, s))
+		return s;
+	drw->shm = 0; /* not available, stay server-side */
+#endif /* XSHM */
+	s->pixmap = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+	return s;
+}
+
+void
+drw_surf_free(Drw *drw, Surf *s)
+{
+	if (!s)
+		return;
+	if (drw->surf == s)
+		drw_select(drw, NULL);
+#ifdef XSHM
+	if (s->image)
+		surf_shm_free(drw, s);
+#endif /* XSHM */
+	if (s->pixmap)
+		XFreePixmap(drw->dpy, s->pixmap);
+	free(s);
+}
+
 /* This function is an implementation detail. Library users should use
  * drw_fontset_create instead.
  */
@@ -162,6 +526,19 @@ xfont_free(Fnt *font)
 		return;
 	if (font->pattern)
 		FcPatternDestroy(font->pattern);
+#ifdef XSHM
+	if (font->glyphs) {
+		Glyphs *gs = font->glyphs;
+		size_t i;
+
+		for (i = 0; i < GLYPHCACHE; i++)
+			if (gs->slot[i]) {
+				free(gs->slot[i]->alpha);
+				free(gs->slot[i]);
+			}
+		free(gs);
+	}
+#endif /* XSHM */
 	XftFontClose(font->dpy, font->xfont);
 	free(font);
 }
@@ -236,16 +613,39 @@ drw_setscheme(Drw *drw, Clr *scm)
 		drw->scheme = scm;
 }
 
+static void
+fill(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned long pixel)
+{
+#ifdef XSHM
+	if (drw->surf && drw->surf->image) {
+		surf_wait(drw, drw->surf);
+		surf_fill(drw->surf, x, y, w, h, pixel);
+		return;
+	}
+#endif /* XSHM */
+	XSetForeground(drw->dpy, drw->gc, pixel);
+	XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
+}
+
 void
 drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert)
 {
+	unsigned long pixel;
+
 	if (!drw || !drw->scheme)
 		return;
-	XSetForeground(drw->dpy, drw->gc, invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel);
-	if (filled)
-		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
-	else
+	pixel = invert ? drw->scheme[ColBg].pixel : drw->scheme[ColFg].pixel;
+	if (filled) {
+		fill(drw, x, y, w, h, pixel);
+	} else if (drw->surf && drw->surf->image) {
+		fill(drw, x, y, w, 1, pixel);
+		fill(drw, x, y + h - 1, w, 1, pixel);
+		fill(drw, x, y, 1, h, pixel);
+		fill(drw, x + w - 1, y, 1, h, pixel);
+	} else {
+		XSetForeground(drw->dpy, drw->gc, pixel);
 		XDrawRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w - 1, h - 1);
+	}
 }
 
 int
@@ -272,11 +672,11 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	if (!render) {
 		w = ~w;
 	} else {
-		XSetForeground(drw->dpy, drw->gc, drw->scheme[invert ? ColFg : ColBg].pixel);
-		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
-		d = XftDrawCreate(drw->dpy, drw->drawable,
-		                  DefaultVisual(drw->dpy, drw->screen),
-		                  DefaultColormap(drw->dpy, drw->screen));
+		fill(drw, x, y, w, h, drw->scheme[invert ? ColFg : ColBg].pixel);
+		if (!drw->surf || !drw->surf->image)
+			d = XftDrawCreate(drw->dpy, drw->drawable,
+			                  DefaultVisual(drw->dpy, drw->screen),
+			                  DefaultColormap(drw->dpy, drw->screen));
 		x += lpad;
 		w -= lpad;
 	}
@@ -326,8 +726,14 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 
 				if (render) {
 					ty = y + (h - usedfont->h) / 2 + usedfont->xfont->ascent;
-					XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
-					                  usedfont->xfont, x, ty, (XftChar8 *)buf, len);
+					if (d)
+						XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
+						                  usedfont->xfont, x, ty, (XftChar8 *)buf, len);
+#ifdef XSHM
+					else
+						surf_string(drw, drw->surf, usedfont, &drw->scheme[invert ? ColBg : ColFg],
+						            x, ty, buf, len);
+#endif /* XSHM */
 				}
 				x += ew;
 				w -= ew;
@@ -389,8 +795,21 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 	if (!drw)
 		return;
 
+#ifdef XSHM
+	if (drw->surf && drw->surf->image) {
+		if (x < 0 || y < 0 || x >= (int)drw->surf->w || y >= (int)drw->surf->h)
+			return;
+		w = MIN(w, drw->surf->w - x);
+		h = MIN(h, drw->surf->h - y);
+		/* the image must not change before the server has copied it,
+		 * surf_wait() sees to that when it is drawn on next */
+		drw->surf->put = NextRequest(drw->dpy);
+		XShmPutImage(drw->dpy, win, drw->gc, drw->surf->image, x, y, x, y, w, h, False);
+		return;
+	}
+#endif /* XSHM */
+	/* flushed by the event loop before it sleeps */
 	XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
-	XSync(drw->dpy, False);
 }
 
 unsigned int
@@ -9,18 +9,30 @@ typedef struct Fnt {
 	unsigned int h;
 	XftFont *xfont;
 	FcPattern *pattern;
+	void *glyphs;           /* rendered glyphs of client-side drawing */
 	struct Fnt *next;
 } Fnt;
 
 enum { ColFg, ColBg, ColBorder }; /* Clr scheme index */
 typedef XftColor Clr;
 
+typedef struct {
+	unsigned int w, h;
+	Pixmap pixmap;          /* drawn by the server */
+	XImage *image;          /* or drawn client-side in shared memory */
+	void *shminfo;
+	unsigned long put;      /* request of the last put of image, 0 if done */
+} Surf;
+
 typedef struct {
 	unsigned int w, h;
 	Display *dpy;
 	int screen;
 	Window root;
-	Drawable drawable;
+	Drawable drawable;      /* target of the drawing functions */
+	Pixmap pixmap;          /* owned drawable, None if created without size */
+	Surf *surf;             /* selected surface, NULL for the own pixmap */
+	int shm;                /* surfaces are created in shared memory */
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
@@ -30,6 +42,12 @@ typedef struct {
 Drw *drw_create(Display *dpy, int screen, Window win, unsigned int w, unsigned int h);
 void drw_resize(Drw *drw, unsigned int w, unsigned int h);
 void drw_free(Drw *drw);
+void drw_select(Drw *drw, Surf *s);
+
+/* Surface abstraction */
+int drw_shm_enable(Drw *drw);
+Surf *drw_surf_create(Drw *drw, unsigned int w, unsigned int h);
+void drw_surf_free(Drw *drw, Surf *s);
 
 /* Fnt abstraction */
 Fnt *drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount);
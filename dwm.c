@@ -21,12 +21,16 @@
  * To understand everything else, start reading main().
  */
 #include <errno.h>
+#include <fnmatch.h>
 #include <locale.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -41,23 +45,46 @@
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#endif /* XCB */
+#ifdef XSYNC
+#include <X11/extensions/sync.h>
+#endif /* XSYNC */
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif /* XRANDR */
 #include <X11/Xft/Xft.h>
 
 #include "drw.h"
+#include "ipc.h"
+#include "layout.h"
 #include "util.h"
 
 /* macros */
 #define BUTTONMASK              (ButtonPressMask|ButtonReleaseMask)
 #define CLEANMASK(mask)         (mask & ~(numlockmask|LockMask) & (ShiftMask|ControlMask|Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|Mod5Mask))
+#define CLIENTMASK              (EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask)
 #define INTERSECT(x,y,w,h,m)    (MAX(0, MIN((x)+(w),(m)->wx+(m)->ww) - MAX((x),(m)->wx)) \
                                * MAX(0, MIN((y)+(h),(m)->wy+(m)->wh) - MAX((y),(m)->wy)))
+#define INSIDE(x,y,m)           ((x) >= (m)->wx && (x) < (m)->wx + (m)->ww \
+                               && (y) >= (m)->wy && (y) < (m)->wy + (m)->wh)
 #define ISVISIBLE(C)            ((C->tags & C->mon->tagset[C->mon->seltags]))
 #define LENGTH(X)               (sizeof X / sizeof X[0])
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
 #define WIDTH(X)                ((X)->w + 2 * (X)->bw)
 #define HEIGHT(X)               ((X)->h + 2 * (X)->bw)
+#define ROOTMASK                (SubstructureRedirectMask|SubstructureNotifyMask|ButtonPressMask \
+                               |PointerMotionMask|EnterWindowMask|LeaveWindowMask \
+                               |StructureNotifyMask|PropertyChangeMask)
 #define TAGMASK                 ((1 << LENGTH(tags)) - 1)
 #define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define TITLEMAX                256 /* bytes of a title kept, with the NUL */
+#define CLASSMAX                64  /* bytes of a WM_CLASS part kept, with the NUL */
+#define TRACEATOM               ((unsigned long)-2) /* tag of a trace record naming an atom */
+#define TRACEBATCH              0x8000 /* trace record flags beside the length: */
+#define TRACEMERGED             0x4000 /* first of a batch, coalesced into the one before */
+#define TRACELEN                0x3fff
 
 #define GAP_TOGGLE 100
 #define GAP_RESET  0
@@ -67,10 +94,18 @@ enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
 enum { SchemeNorm, SchemeSel }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
        NetWMFullscreen, NetActiveWindow, NetWMWindowType,
-       NetWMWindowTypeDialog, NetClientList, NetLast }; /* EWMH atoms */
+       NetWMWindowTypeDialog, NetClientList, NetClientListStacking,
+       NetLast }; /* EWMH atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
        ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { GrabNone, GrabUnfocused, GrabFocused }; /* client button grab sets */
+enum { BarTags = 1, BarLayout = 2, BarTitle = 4, BarStatus = 8,
+       BarAll = 15 }; /* bar regions */
+enum { IpcArgNone, IpcArgInt, IpcArgUint, IpcArgFloat,
+       IpcArgLayout }; /* ipc command argument types */
+enum { IpcEvFocus, IpcEvTag, IpcEvLayout, IpcEvClient,
+       IpcEvLast }; /* ipc event classes */
 
 typedef union {
 	int i;
@@ -90,19 +125,78 @@ typedef struct {
 typedef struct Monitor Monitor;
 typedef struct Client Client;
 struct Client {
-	char name[256];
-	float mina, maxa;
-	int x, y, w, h;
-	int oldx, oldy, oldw, oldh;
-	int basew, baseh, incw, inch, maxw, maxh, minw, minh;
-	int bw, oldbw;
-	unsigned int tags;
-	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
-	Client *next;
-	Client *snext;
+	/* hot, what list walks, ISVISIBLE() and the layouts read, fits the
+	 * first cache line of a pooled client, see ClientHot */
+	Client *next;         /* client list */
+	Client *snext;        /* stack */
 	Monitor *mon;
 	Window win;
+	unsigned int tags;
+	int isfloating;
+	int x, y, w, h;
+	/* cold, prev and sprev are only followed to unlink a client */
+	char *name;           /* UTF-8 title, NUL terminated */
+	Client *prev;         /* prev is NULL at the head */
+	Client *sprev;
+	int bw, isfullscreen;
+	unsigned int namelen, namesize;
+	unsigned long namehash;
+	Hints hints;
+	int oldx, oldy, oldw, oldh;
+	int oldbw;
+	int isfixed, isurgent, neverfocus, oldstate;
+	int hidden;           /* unmapped by showhide(), see unmaphidden */
+	int grabs;
+	int stackpos;         /* place in the order restacktiled() sent last, */
+	unsigned long stackgen; /* valid while equal to the monitor's stackgen */
 };
+struct ClientHot { char exceedsline[offsetof(Client, name) > CACHELINE ? -1 : 1]; };
+
+typedef struct {
+	const char *name;
+	void (*func)(const Arg *);
+	unsigned int argtype;
+} IpcCommand;
+
+/* window properties read by manage(), fetched up front */
+typedef struct {
+	char name[TITLEMAX];
+	unsigned int namelen;
+	char instance[CLASSMAX], class[CLASSMAX];
+	Window trans;
+	Atom state, wtype;
+	XSizeHints size;      /* size.flags is 0 without WM_NORMAL_HINTS */
+	XWMHints wmh;         /* wmh.flags is 0 without WM_HINTS */
+} Props;
+
+typedef struct {
+	const char *name;
+	Atom *atom;
+} AtomReq;
+
+typedef struct {
+	unsigned long from, to; /* recorded window or atom, its replay counterpart */
+} TraceId;
+
+/* replay: recorded ids to their counterparts, open addressing */
+typedef struct {
+	TraceId *ids;
+	unsigned int n, size;
+} TraceMap;
+
+typedef struct {
+	int x, y;              /* latest pointer position */
+	int moved, released;
+	int waiting;           /* for the client to paint the last step */
+	long now, next, wait;  /* microseconds since the start */
+	long period;           /* one frame of the monitor */
+	struct timespec start;
+#ifdef XSYNC
+	XSyncCounter counter;
+	XSyncAlarm alarm;
+	XSyncValue value;
+#endif /* XSYNC */
+} Drag;
 
 typedef struct {
 	unsigned int mod;
@@ -116,6 +210,16 @@ typedef struct {
 	void (*arrange)(Monitor *);
 } Layout;
 
+/* inputs of the last layout of a monitor, see arranged() */
+typedef struct {
+	const Layout *lt;
+	int wx, wy, ww, wh, gap, nmaster, nvisible, n;
+	float mfact;
+	Client **tiled;
+	int size;
+	int valid;
+} Arranged;
+
 typedef struct {
 	int isgap;
 	int realgap;
@@ -136,69 +240,146 @@ struct Monitor {
 	unsigned int tagset[2];
 	int showbar;
 	int topbar;
+	int barsel;           /* bar was last drawn as the selected monitor's */
+	int bardirty;         /* bar regions drawn after the current event batch */
+	int bartw;            /* width of the status as last drawn */
+	int refresh;          /* refresh rate in Hz, 0 if unknown */
+	Atom output;          /* RandR monitor name, identifies the monitor */
+	char name[32];
+	Window *stacked;      /* tiled windows as last stacked, top to bottom */
+	int nstacked, stackedsize;
+	unsigned long stackgen; /* of the order in stacked, see restacktiled() */
+	int nclients;         /* clients, and per tag (at most 31), see tagcount() */
+	int ntagged[31], nurgent[31];
+	unsigned int occ, urg; /* tags with clients, with urgent ones */
+	Client **visible;     /* visible clients in list order, see updatetiled() */
+	Client **tiled;       /* the tiled ones among them */
+	int nvisible, ntiled, tiledsize, tiledstale;
+	Arranged last;
 	Client *clients;
 	Client *sel;
 	Client *stack;
 	Monitor *next;
 	Window barwin;
+	Surf *barbuf;         /* back buffer of the bar */
+	int bardrawn;
 	const Layout *lt[2];
 };
 
+typedef struct {
+	const char *class;
+	const char *instance;
+	const char *title;
+	const char *wintype;
+	unsigned int tags;
+	int isfloating;
+	int monitor;
+} Rule;
+
 /* function declarations */
+static void applygeom(Monitor *m, Rect *r);
+static void applyrules(Client *c, Props *p);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
+static int arranged(Monitor *m);
+static void arrangetiled(Monitor *m, void (*layout)(const Tiling *, Rect *));
+static void atomreg(Atom *atom, const char *name);
+static void atomsintern(void);
 static void attach(Client *c);
+static void attachafter(Client *c, Client *a);
 static void attachstack(Client *c);
 static void buttonpress(XEvent *e);
+static void centeredmaster(Monitor *m);
 static void checkotherwm(void);
+static unsigned long classcpy(char *dst, const char *s, unsigned long n);
 static void cleanup(void);
 static void cleanupmon(Monitor *mon);
 static void clientmessage(XEvent *e);
+static void compilerules(const Rule *r, int n);
 static void configure(Client *c);
 static void configurenotify(XEvent *e);
 static void configurerequest(XEvent *e);
 static Monitor *createmon(void);
+static void deck(Monitor *m);
 static void destroynotify(XEvent *e);
 static void detach(Client *c);
 static void detachstack(Client *c);
 static Monitor *dirtomon(int dir);
+static void dirtybar(Monitor *m, int parts);
+static void dispatch(XEvent *ev);
+static void dragend(Drag *d);
+static Bool dragevent(Display *dpy, XEvent *ev, XPointer arg);
+static int dragnext(Drag *d);
+static void dragplace(Client *c, int x, int y, int w, int h);
+static void dragstart(Drag *d, Client *c, int sync);
+static void dragsync(Drag *d, Client *c);
 static void drawbar(Monitor *m);
+static void drawbarparts(Monitor *m, int parts);
 static void drawbars(void);
+static void drawdirtybars(void);
 static void enternotify(XEvent *e);
+#ifdef EVSTATS
+static void evbegin(void);
+static void evdump(void);
+static void evend(int type);
+#endif /* EVSTATS */
 static void expose(XEvent *e);
+static int external(void (*func)(const Arg *));
 static void focus(Client *c);
 static void focusin(XEvent *e);
 static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
 static void gap_copy(Gap *to, const Gap *from);
-static Atom getatomprop(Client *c, Atom prop);
+static void geomalloc(int n);
+static Atom getatomprop(Window w, Atom prop);
+static void getprops(Window w, Props *p);
 static int getrootptr(int *x, int *y);
+#ifndef XCB
 static long getstate(Window w);
+#endif /* XCB */
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
+static unsigned int gettitle(Window w, char *name);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
+static void grid(Monitor *m);
 static void incnmaster(const Arg *arg);
+static void ipcevent(int ev, Monitor *m, Client *c, const char *action);
+static void ipcmessage(IpcClient *ic, char *msg);
+static const char *ipcpath(void);
+static void ipcstate(IpcBuf *b);
+static void ipcstats(IpcBuf *b);
+static const char *ipcsubscribe(IpcClient *ic, int on, char *val);
 static void keypress(XEvent *e);
 static void killclient(const Arg *arg);
-static void manage(Window w, XWindowAttributes *wa);
+static void manage(Window w, XWindowAttributes *wa, Props *p);
 static void mappingnotify(XEvent *e);
 static void maprequest(XEvent *e);
 static void monocle(Monitor *m);
 static void motionnotify(XEvent *e);
 static void movemouse(const Arg *arg);
 static Client *nexttiled(Client *c);
+static void placeclient(Client *c, int x, int y, int w, int h);
+static Monitor *pointtomon(int x, int y);
 static void pop(Client *);
 static Client *prevtiled(Client *c);
 static void propertynotify(XEvent *e);
 static void pushdown(const Arg *arg);
 static void pushup(const Arg *arg);
 static void quit(const Arg *arg);
+#ifdef XRANDR
+static void randrnotify(XEvent *e);
+#endif /* XRANDR */
 static Monitor *recttomon(int x, int y, int w, int h);
+static void replay(const char *path);
 static void resize(Client *c, int x, int y, int w, int h, int interact);
+static void rescreen(int dirty);
 static void resizeclient(Client *c, int x, int y, int w, int h);
 static void resizemouse(const Arg *arg);
 static void restack(Monitor *m);
+static int restacktiled(Monitor *m);
+static unsigned long rulehash(const char *s);
+static int rulematch(const char *pattern, const char *s);
 static void run(void);
 static void runautostart(void);
 static void scan(void);
@@ -210,29 +391,55 @@ static void setfullscreen(Client *c, int fullscreen);
 static void setgaps(const Arg *arg);
 static void setlayout(const Arg *arg);
 static void setmfact(const Arg *arg);
+static void setshmbar(const Arg *arg);
+static void setsizehints(Client *c, XSizeHints *size);
+static int settitle(Client *c, const char *name, unsigned int len);
 static void setup(void);
 static void seturgent(Client *c, int urg);
+static void setwindowtype(Client *c, Atom state, Atom wtype);
+static void setwmhints(Client *c, XWMHints *wmh);
 static void showhide(Client *c);
 static void sigchld(int unused);
+#ifdef EVSTATS
+static void sigusr2(int unused);
+#endif /* EVSTATS */
 static void spawn(const Arg *arg);
+static void stackplace(Window w, Window sibling);
+static void stackremove(Window w);
 static void tag(const Arg *arg);
+static void tagcount(Client *c, int d);
 static void tagmon(const Arg *arg);
-static void tile(Monitor *);
+static void tile(Monitor *m);
+static unsigned int titlecpy(char *dst, const unsigned char *s, unsigned long n, int latin1);
 static void togglebar(const Arg *arg);
 static void togglefloating(const Arg *arg);
 static void toggletag(const Arg *arg);
 static void toggleview(const Arg *arg);
+static void traceatom(Atom a);
+static void tracebind(TraceMap *t, unsigned long from, unsigned long to);
+static unsigned long tracemap(TraceMap *t, unsigned long from);
+static Atom tracemapatom(Atom a);
+static int traceread(XEvent *ev, int *flags);
+static unsigned int tracesize(int type);
+static void tracestart(const char *path);
+static void tracewin(Window w, unsigned long tag);
+static void tracewrite(XEvent *ev, int flags);
+static void tracexlate(XEvent *ev);
 static void unfocus(Client *c, int setfocus);
 static void unmanage(Client *c, int destroyed);
 static void unmapnotify(XEvent *e);
+static void unstack(Monitor *m, Window w);
 static void updatebarpos(Monitor *m);
 static void updatebars(void);
-static void updateclientlist(void);
+static void updateclientlist(Window w, int add);
+static void updateclientstacking(void);
 static int updategeom(void);
+static void updatemonindex(void);
 static void updatenumlockmask(void);
 static void updatesizehints(Client *c);
 static void updatestatus(void);
-static void updatetitle(Client *c);
+static void updatetiled(Monitor *m);
+static int updatetitle(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
 static void view(const Arg *arg);
@@ -280,13 +487,108 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 	[UnmapNotify] = unmapnotify
 };
 static Atom wmatom[WMLast], netatom[NetLast];
+static const char *wmatomnames[WMLast] = {
+	[WMProtocols] = "WM_PROTOCOLS",
+	[WMDelete] = "WM_DELETE_WINDOW",
+	[WMState] = "WM_STATE",
+	[WMTakeFocus] = "WM_TAKE_FOCUS"
+};
+static const char *netatomnames[NetLast] = {
+	[NetSupported] = "_NET_SUPPORTED",
+	[NetWMName] = "_NET_WM_NAME",
+	[NetWMState] = "_NET_WM_STATE",
+	[NetWMCheck] = "_NET_SUPPORTING_WM_CHECK",
+	[NetWMFullscreen] = "_NET_WM_STATE_FULLSCREEN",
+	[NetActiveWindow] = "_NET_ACTIVE_WINDOW",
+	[NetWMWindowType] = "_NET_WM_WINDOW_TYPE",
+	[NetWMWindowTypeDialog] = "_NET_WM_WINDOW_TYPE_DIALOG",
+	[NetClientList] = "_NET_CLIENT_LIST",
+	[NetClientListStacking] = "_NET_CLIENT_LIST_STACKING"
+};
+static AtomReq *atomreqs;
+static unsigned int natomreqs;
+static Window *clientlist;   /* managed windows in mapping order */
+static unsigned int nclientlist, clientlistsize;
+static Window *stacklist;    /* managed windows and bars bottom to top, see stackplace() */
+static Window *stacksent;    /* the managed ones as last published */
+static unsigned int nstacklist, nstacksent, stacklistsize;
+static Window *restackwin;   /* restacktiled() buffers */
+static int *restackpos, restacksize;
+static unsigned long stackgen;
 static int running = 1;
+static int scanning = 0;
+static int winmoved = 0; /* windows moved or (un)mapped since restack() synced */
+static Atom utf8string;
+#ifdef XSYNC
+static Atom syncatom[2];      /* _NET_WM_SYNC_REQUEST and its counter */
+static int syncevbase = -1;
+#endif /* XSYNC */
+#ifdef XRANDR
+static int randrevbase = -1; /* RandR 1.5 is used for monitors if set */
+#endif /* XRANDR */
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
 static Drw *drw;
+static Ipc *ipc;
 static Monitor *mons, *selmon;
+static Rect *geom;           /* layout input and output, see geomalloc() */
+static int *geombw, geomsize;
+static const Hints **geomhints;
+static Pool clientpool = { sizeof(Client) }, monpool = { sizeof(Monitor) };
+static Monitor *ptrmon;      /* monitor the pointer was last seen on */
+static Monitor **monindex;   /* monitors by left edge, for pointtomon() */
+static int nmonindex, monindexw;
+static unsigned long motionevents, motioncoalesced, motionlookups;
+static unsigned long arrangeruns, arrangeskips;
+static unsigned long xevents, xidles; /* events handled, times run() went idle */
+#ifdef EVSTATS
+#define HISTSUB 3 /* log2 of the linear steps within a power of two */
+static struct {
+	unsigned long count, requests, waits;
+	unsigned long long ns, max;
+} evstats[LASTEvent];        /* by event type, [0] gets extension events */
+static unsigned long evhist[(65 - HISTSUB) << HISTSUB]; /* dispatch times in ns */
+static struct timespec evt0;
+static unsigned long evreq0;
+static volatile sig_atomic_t evdumpreq;
+static const char *evnames[LASTEvent] = {
+	[0] = "extension", [KeyPress] = "KeyPress", [KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress", [ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify", [EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify", [FocusIn] = "FocusIn", [FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify", [Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose", [NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify", [CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify", [UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify", [MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify", [ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest", [GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest", [CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest", [PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear", [SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify", [ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage", [MappingNotify] = "MappingNotify",
+	[GenericEvent] = "GenericEvent"
+};
+#endif /* EVSTATS */
+static FILE *traceout, *tracein; /* event trace being recorded or replayed */
+static struct timespec tracelast;
+static TraceMap tracewins, traceatoms; /* atoms: recorded ones when recording */
+static const Rule *ruleset;  /* rules[], see compilerules() */
+static int *rulebuckets;     /* exact class rules by rulehash() */
+static int *rulenext;        /* next rule of the same bucket, -1 ends it */
+static int *ruleglob;        /* the other rules, tried one by one */
+static int nruleglob;
+static unsigned long rulemask;
+static Atom *ruletypes;      /* window types of the rules */
 static Window root, wmcheckwin;
+static const char *ipcevnames[IpcEvLast] = {
+	[IpcEvFocus] = "focus",
+	[IpcEvTag] = "tag",
+	[IpcEvLayout] = "layout",
+	[IpcEvClient] = "client"
+};
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
@@ -295,10 +597,62 @@ static Window root, wmcheckwin;
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 
 /* function implementations */
+/* Configures the tiled clients of m to the rectangles in r, computed by a
+ * layout with the size hints applied, and syncs once for all of them. */
+void
+applygeom(Monitor *m, Rect *r)
+{
+	int i, moved = 0;
+	Client *c;
+
+	for (i = 0; i < m->ntiled; i++) {
+		c = m->tiled[i];
+		if (r[i].x != c->x || r[i].y != c->y || r[i].w != c->w || r[i].h != c->h) {
+			placeclient(c, r[i].x, r[i].y, r[i].w, r[i].h);
+			moved = 1;
+		}
+	}
+	if (moved)
+		XSync(dpy, False);
+}
+
+/* Applies the rules matching the window to c in the order of ruleset. The
+ * ones for an exact class come from their hash bucket, the others are
+ * tried one by one. */
+void
+applyrules(Client *c, Props *p)
+{
+	const Rule *r;
+	Monitor *m;
+	int i, j = 0, k;
+
+	c->isfloating = 0;
+	c->tags = 0;
+	i = rulebuckets[rulehash(p->class) & rulemask];
+	while (i >= 0 || j < nruleglob) {
+		if (i >= 0 && (j >= nruleglob || i < ruleglob[j])) {
+			k = i;
+			i = rulenext[i];
+		} else
+			k = ruleglob[j++];
+		r = &ruleset[k];
+		if (rulematch(r->class, p->class)
+		&& rulematch(r->instance, p->instance)
+		&& rulematch(r->title, c->name)
+		&& (!r->wintype || ruletypes[k] == p->wtype))
+		{
+			c->isfloating = r->isfloating;
+			c->tags |= r->tags;
+			for (m = mons; m && m->num != r->monitor; m = m->next);
+			if (m)
+				c->mon = m;
+		}
+	}
+}
+
 int
 applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 {
-	int baseismin;
 	Monitor *m = c->mon;
 
 	/* set minimum possible */
@@ -327,37 +681,8 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 		*h = bh;
 	if (*w < bh)
 		*w = bh;
-	if (resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange) {
-		/* see last two sentences in ICCCM 4.1.2.3 */
-		baseismin = c->basew == c->minw && c->baseh == c->minh;
-		if (!baseismin) { /* temporarily remove base dimensions */
-			*w -= c->basew;
-			*h -= c->baseh;
-		}
-		/* adjust for aspect limits */
-		if (c->mina > 0 && c->maxa > 0) {
-			if (c->maxa < (float)*w / *h)
-				*w = *h * c->maxa + 0.5;
-			else if (c->mina < (float)*h / *w)
-				*h = *w * c->mina + 0.5;
-		}
-		if (baseismin) { /* increment calculation requires this */
-			*w -= c->basew;
-			*h -= c->baseh;
-		}
-		/* adjust for increment value */
-		if (c->incw)
-			*w -= *w % c->incw;
-		if (c->inch)
-			*h -= *h % c->inch;
-		/* restore base dimensions */
-		*w = MAX(*w + c->basew, c->minw);
-		*h = MAX(*h + c->baseh, c->minh);
-		if (c->maxw)
-			*w = MIN(*w, c->maxw);
-		if (c->maxh)
-			*h = MIN(*h, c->maxh);
-	}
+	if (resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange)
+		lt_hints(&c->hints, w, h);
 	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 }
 
@@ -378,22 +703,152 @@ arrange(Monitor *m)
 void
 arrangemon(Monitor *m)
 {
-	strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
-	if (m->lt[m->sellt]->arrange)
-		m->lt[m->sellt]->arrange(m);
+	const Layout *lt = m->lt[m->sellt];
+
+	if (arranged(m)) {
+		arrangeskips++;
+		return;
+	}
+	arrangeruns++;
+	strncpy(m->ltsymbol, lt->symbol, sizeof m->ltsymbol);
+	if (lt->arrange)
+		lt->arrange(m);
+}
+
+/* Returns 1 if the layout of m would come out as last time, else records
+ * its inputs for the next call. */
+int
+arranged(Monitor *m)
+{
+	Arranged *a = &m->last;
+	const Layout *lt = m->lt[m->sellt];
+
+	if (!lt->arrange) {
+		a->valid = 0;
+		return 0;
+	}
+	updatetiled(m);
+	if (a->valid && a->lt == lt && a->n == m->ntiled && a->nvisible == m->nvisible
+	&& a->wx == m->wx && a->wy == m->wy && a->ww == m->ww && a->wh == m->wh
+	&& a->gap == m->gap->gappx && a->mfact == m->mfact && a->nmaster == m->nmaster
+	&& !memcmp(a->tiled, m->tiled, m->ntiled * sizeof(Client *)))
+		return 1;
+	if (m->ntiled > a->size) {
+		a->size = m->tiledsize;
+		free(a->tiled);
+		a->tiled = ecalloc(a->size, sizeof(Client *));
+	}
+	memcpy(a->tiled, m->tiled, m->ntiled * sizeof(Client *));
+	a->lt = lt;
+	a->n = m->ntiled;
+	a->nvisible = m->nvisible;
+	a->wx = m->wx;
+	a->wy = m->wy;
+	a->ww = m->ww;
+	a->wh = m->wh;
+	a->gap = m->gap->gappx;
+	a->mfact = m->mfact;
+	a->nmaster = m->nmaster;
+	a->valid = 1;
+	return 0;
+}
+
+/* Runs a layout of layout.c over the tiled clients of m and applies it. */
+void
+arrangetiled(Monitor *m, void (*layout)(const Tiling *, Rect *))
+{
+	int i;
+	Tiling t;
+
+	updatetiled(m);
+	if (m->ntiled == 0)
+		return;
+	geomalloc(m->ntiled);
+	for (i = 0; i < m->ntiled; i++) {
+		geombw[i] = m->tiled[i]->bw;
+		geomhints[i] = &m->tiled[i]->hints;
+	}
+	t.wa.x = m->wx;
+	t.wa.y = m->wy;
+	t.wa.w = m->ww;
+	t.wa.h = m->wh;
+	t.gap = m->gap->gappx;
+	t.min = bh; /* as applysizehints() does for the others */
+	t.mfact = m->mfact;
+	t.nmaster = m->nmaster;
+	t.n = m->ntiled;
+	t.bw = geombw;
+	t.hints = resizehints ? geomhints : NULL;
+	layout(&t, geom);
+	applygeom(m, geom);
+}
+
+/* Queues an atom to be interned by the next atomsintern() call. */
+void
+atomreg(Atom *atom, const char *name)
+{
+	if (natomreqs % 16 == 0
+	&& !(atomreqs = realloc(atomreqs, (natomreqs + 16) * sizeof(AtomReq))))
+		die("realloc:");
+	atomreqs[natomreqs].name = name;
+	atomreqs[natomreqs].atom = atom;
+	natomreqs++;
+}
+
+/* Interns all queued atoms in a single round trip. */
+void
+atomsintern(void)
+{
+	char **names;
+	Atom *atoms;
+	unsigned int i;
+
+	if (!natomreqs)
+		return;
+	names = ecalloc(natomreqs, sizeof(char *));
+	atoms = ecalloc(natomreqs, sizeof(Atom));
+	for (i = 0; i < natomreqs; i++)
+		names[i] = (char *)atomreqs[i].name;
+	if (!XInternAtoms(dpy, names, natomreqs, False, atoms))
+		die("dwm: cannot intern atoms");
+	for (i = 0; i < natomreqs; i++)
+		*atomreqs[i].atom = atoms[i];
+	free(atoms);
+	free(names);
+	free(atomreqs);
+	atomreqs = NULL;
+	natomreqs = 0;
 }
 
 void
 attach(Client *c)
 {
-	c->next = c->mon->clients;
-	c->mon->clients = c;
+	attachafter(c, NULL);
+}
+
+/* Links c into the client list of its monitor after a, or at the head if
+ * a is NULL. */
+void
+attachafter(Client *c, Client *a)
+{
+	c->prev = a;
+	c->next = a ? a->next : c->mon->clients;
+	if (c->next)
+		c->next->prev = c;
+	if (a)
+		a->next = c;
+	else
+		c->mon->clients = c;
+	c->mon->tiledstale = 1;
 }
 
 void
 attachstack(Client *c)
 {
+	c->sprev = NULL;
 	c->snext = c->mon->stack;
+	if (c->snext)
+		c->snext->sprev = c;
 	c->mon->stack = c;
 }
 
@@ -435,10 +890,17 @@ buttonpress(XEvent *e)
 	}
 	for (i = 0; i < LENGTH(buttons); i++)
 		if (click == buttons[i].click && buttons[i].func && buttons[i].button == ev->button
-		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
+		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state)
+		&& !(tracein && external(buttons[i].func)))
 			buttons[i].func(click == ClkTagBar && buttons[i].arg.i == 0 ? &arg : &buttons[i].arg);
 }
 
+void
+centeredmaster(Monitor *m)
+{
+	arrangetiled(m, lt_centeredmaster);
+}
+
 void
 checkotherwm(void)
 {
@@ -450,6 +912,20 @@ checkotherwm(void)
 	XSync(dpy, False);
 }
 
+/* Copies the string s, ending at a NUL or after n bytes, into dst (CLASSMAX
+ * bytes) and returns its length in s. */
+unsigned long
+classcpy(char *dst, const char *s, unsigned long n)
+{
+	unsigned long len;
+
+	for (len = 0; len < n && s[len]; len++);
+	n = MIN(len, CLASSMAX - 1);
+	memcpy(dst, s, n);
+	dst[n] = '\0';
+	return len;
+}
+
 void
 cleanup(void)
 {
@@ -471,6 +947,28 @@ cleanup(void)
 	for (i = 0; i < LENGTH(colors); i++)
 		free(scheme[i]);
 	XDestroyWindow(dpy, wmcheckwin);
+	free(clientlist);
+	free(monindex);
+	free(stacklist);
+	free(stacksent);
+	free(restackwin);
+	free(restackpos);
+	free(geom);
+	free(geombw);
+	free(geomhints);
+	free(rulebuckets);
+	free(rulenext);
+	free(ruleglob);
+	free(ruletypes);
+	free(tracewins.ids);
+	free(traceatoms.ids);
+	if (traceout)
+		fclose(traceout);
+	if (tracein)
+		fclose(tracein);
+	pool_release(&clientpool);
+	pool_release(&monpool);
+	ipc_free(ipc);
 	drw_free(drw);
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
@@ -488,9 +986,17 @@ cleanupmon(Monitor *mon)
 		for (m = mons; m && m->next != mon; m = m->next);
 		m->next = mon->next;
 	}
+	if (mon == ptrmon)
+		ptrmon = NULL;
 	XUnmapWindow(dpy, mon->barwin);
 	XDestroyWindow(dpy, mon->barwin);
-	free(mon);
+	stackremove(mon->barwin);
+	drw_surf_free(drw, mon->barbuf);
+	free(mon->stacked);
+	free(mon->visible);
+	free(mon->tiled);
+	free(mon->last.tiled);
+	pool_free(&monpool, mon);
 }
 
 void
@@ -512,6 +1018,37 @@ clientmessage(XEvent *e)
 	}
 }
 
+/* Sorts the n rules of r into hash buckets by class where it is matched
+ * exactly and a list of the rest, both in the order of r, so that the cost
+ * of applyrules() does not grow with the number of exact class rules. */
+void
+compilerules(const Rule *r, int n)
+{
+	int i, *b;
+
+	ruleset = r;
+	nruleglob = 0;
+	for (rulemask = 1; rulemask < 2 * n; rulemask <<= 1);
+	rulebuckets = ecalloc(rulemask, sizeof(int));
+	memset(rulebuckets, -1, rulemask * sizeof(int));
+	rulemask--;
+	rulenext = ecalloc(MAX(n, 1), sizeof(int));
+	ruleglob = ecalloc(MAX(n, 1), sizeof(int));
+	ruletypes = ecalloc(MAX(n, 1), sizeof(Atom));
+	for (i = n - 1; i >= 0; i--)
+		if (r[i].class && !strpbrk(r[i].class, "*?[\\")) {
+			b = &rulebuckets[rulehash(r[i].class) & rulemask];
+			rulenext[i] = *b;
+			*b = i;
+		}
+	for (i = 0; i < n; i++) {
+		if (!r[i].class || strpbrk(r[i].class, "*?[\\"))
+			ruleglob[nruleglob++] = i;
+		if (r[i].wintype)
+			atomreg(&ruletypes[i], r[i].wintype);
+	}
+}
+
 void
 configure(Client *c)
 {
@@ -534,28 +1071,18 @@ configure(Client *c)
 void
 configurenotify(XEvent *e)
 {
-	Monitor *m;
-	Client *c;
 	XConfigureEvent *ev = &e->xconfigure;
 	int dirty;
 
-	/* TODO: updategeom handling sucks, needs to be simplified */
+#ifdef XRANDR
+	if (randrevbase >= 0)
+		return; /* randrnotify() follows */
+#endif /* XRANDR */
 	if (ev->window == root) {
 		dirty = (sw != ev->width || sh != ev->height);
 		sw = ev->width;
 		sh = ev->height;
-		if (updategeom() || dirty) {
-			drw_resize(drw, sw, bh);
-			updatebars();
-			for (m = mons; m; m = m->next) {
-				for (c = m->clients; c; c = c->next)
-					if (c->isfullscreen)
-						resizeclient(c, m->mx, m->my, m->mw, m->mh);
-				XMoveResizeWindow(dpy, m->barwin, m->wx + sp, m->by + vp, m->ww -  2 * sp, bh);
-			}
-			focus(NULL);
-			arrange(NULL);
-		}
+		rescreen(dirty);
 	}
 }
 
@@ -616,7 +1143,7 @@ createmon(void)
 {
 	Monitor *m;
 
-	m = ecalloc(1, sizeof(Monitor));
+	m = pool_alloc(&monpool);
 	m->tagset[0] = m->tagset[1] = 1;
 	m->mfact = mfact;
 	m->nmaster = nmaster;
@@ -630,6 +1157,17 @@ createmon(void)
 	return m;
 }
 
+void
+deck(Monitor *m)
+{
+	int n;
+
+	updatetiled(m);
+	if ((n = m->ntiled) > m->nmaster)
+		snprintf(m->ltsymbol, sizeof m->ltsymbol, "D %d", n - m->nmaster);
+	arrangetiled(m, lt_deck);
+}
+
 void
 destroynotify(XEvent *e)
 {
@@ -643,19 +1181,28 @@ destroynotify(XEvent *e)
 void
 detach(Client *c)
 {
-	Client **tc;
-
-	for (tc = &c->mon->clients; *tc && *tc != c; tc = &(*tc)->next);
-	*tc = c->next;
+	if (c->prev)
+		c->prev->next = c->next;
+	else
+		c->mon->clients = c->next;
+	if (c->next)
+		c->next->prev = c->prev;
+	c->next = c->prev = NULL;
+	c->mon->tiledstale = 1;
 }
 
 void
 detachstack(Client *c)
 {
-	Client **tc, *t;
+	Client *t;
 
-	for (tc = &c->mon->stack; *tc && *tc != c; tc = &(*tc)->snext);
-	*tc = c->snext;
+	if (c->sprev)
+		c->sprev->snext = c->snext;
+	else
+		c->mon->stack = c->snext;
+	if (c->snext)
+		c->snext->sprev = c->sprev;
+	c->snext = c->sprev = NULL;
 
 	if (c == c->mon->sel) {
 		for (t = c->mon->stack; t && !ISVISIBLE(t); t = t->snext);
@@ -678,32 +1225,270 @@ dirtomon(int dir)
 	return m;
 }
 
+void
+dirtybar(Monitor *m, int parts)
+{
+	m->bardirty |= parts;
+}
+
+/* Hands an event to its handler. */
+void
+dispatch(XEvent *ev)
+{
+#ifdef EVSTATS
+	evbegin();
+#endif /* EVSTATS */
+	if (ev->type < LASTEvent && handler[ev->type])
+		handler[ev->type](ev); /* call handler */
+#ifdef XRANDR
+	else if (randrevbase >= 0 && (ev->type == randrevbase + RRScreenChangeNotify
+	|| ev->type == randrevbase + RRNotify))
+		randrnotify(ev);
+#endif /* XRANDR */
+#ifdef EVSTATS
+	evend(ev->type);
+#endif /* EVSTATS */
+}
+
+void
+dragend(Drag *d)
+{
+#ifdef XSYNC
+	XEvent ev;
+
+	if (d->alarm)
+		XSyncDestroyAlarm(dpy, d->alarm);
+#endif /* XSYNC */
+	/* the one round trip of the drag, dragplace() did not wait */
+	XSync(dpy, False);
+#ifdef XSYNC
+	if (d->alarm)
+		while (XCheckTypedEvent(dpy, syncevbase + XSyncAlarmNotify, &ev));
+#endif /* XSYNC */
+}
+
+/* Selects the events dragnext() handles. */
+Bool
+dragevent(Display *dpy, XEvent *ev, XPointer arg)
+{
+	switch (ev->type) {
+	case ButtonPress:
+	case ButtonRelease:
+	case MotionNotify:
+	case Expose:
+	case ConfigureRequest:
+	case MapRequest:
+		return True;
+	}
+#ifdef XSYNC
+	return syncevbase >= 0 && ev->type == syncevbase + XSyncAlarmNotify;
+#else
+	return False;
+#endif /* XSYNC */
+}
+
+/* Waits for the next step of an interactive move or resize. Motion is
+ * merged into the latest pointer position, which is handed out at most
+ * once per frame and not while the client is still painting the last
+ * step. Returns 0 once the button was released. */
+int
+dragnext(Drag *d)
+{
+	XEvent ev;
+	struct timespec ts;
+	long timeout;
+
+	/* pointer motion of a drag is not part of a trace */
+	if (d->released || tracein)
+		return 0;
+	for (;;) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		d->now = (ts.tv_sec - d->start.tv_sec) * 1000000
+			+ (ts.tv_nsec - d->start.tv_nsec) / 1000;
+		/* one drain for all of them, so that none is left in the queue
+		 * unseen when we go to sleep on the connection */
+		while (XCheckIfEvent(dpy, &ev, dragevent, NULL)) {
+			switch(ev.type) {
+			case ConfigureRequest:
+			case Expose:
+			case MapRequest:
+				handler[ev.type](&ev);
+				break;
+			case MotionNotify:
+				d->x = ev.xmotion.x;
+				d->y = ev.xmotion.y;
+				d->moved = 1;
+				break;
+			case ButtonRelease:
+				/* the final position is applied regardless of pacing */
+				d->released = 1;
+				return d->moved;
+			case ButtonPress:
+				break; /* another button does not end the drag */
+			default:
+#ifdef XSYNC
+				if (ev.type == syncevbase + XSyncAlarmNotify
+				&& ((XSyncAlarmNotifyEvent *)&ev)->alarm == d->alarm
+				&& XSyncValueGreaterOrEqual(((XSyncAlarmNotifyEvent *)&ev)->counter_value, d->value))
+					d->waiting = 0;
+#endif /* XSYNC */
+				break;
+			}
+		}
+		if (d->waiting && d->now >= d->wait)
+			d->waiting = 0; /* the client is not waited for any longer */
+		if (d->moved && !d->waiting && d->now >= d->next) {
+			d->moved = 0;
+			d->next = d->now + d->period;
+			return 1;
+		}
+		if (d->waiting)
+			timeout = (d->wait - d->now + 999) / 1000;
+		else if (d->moved)
+			timeout = (d->next - d->now + 999) / 1000;
+		else
+			timeout = -1;
+		ipc_poll(NULL, ConnectionNumber(dpy), timeout);
+	}
+}
+
+/* resizeclient() for a step of a drag: the steps are paced already, and
+ * the drain of the next one flushes this one, so it does not wait for the
+ * server. */
+void
+dragplace(Client *c, int x, int y, int w, int h)
+{
+	c->mon->last.valid = 0; /* moved outside a layout */
+	placeclient(c, x, y, w, h);
+}
+
+/* Resizes of a client that sets _NET_WM_SYNC_REQUEST_COUNTER are paced by
+ * its painting if sync is set. */
+void
+dragstart(Drag *d, Client *c, int sync)
+{
+#ifdef XSYNC
+	int n, format, supported = 0;
+	unsigned long nitems, extra;
+	unsigned char *p = NULL;
+	Atom *protocols, type;
+	XSyncAlarmAttributes attr;
+#endif /* XSYNC */
+
+	memset(d, 0, sizeof(Drag));
+	clock_gettime(CLOCK_MONOTONIC, &d->start);
+	d->period = 1000000 / (c->mon->refresh > 0 ? c->mon->refresh : dragrate);
+#ifdef XSYNC
+	if (!sync || syncevbase < 0)
+		return;
+	if (XGetWMProtocols(dpy, c->win, &protocols, &n)) {
+		while (!supported && n--)
+			supported = protocols[n] == syncatom[0];
+		XFree(protocols);
+	}
+	if (!supported)
+		return;
+	if (XGetWindowProperty(dpy, c->win, syncatom[1], 0L, 1L, False, XA_CARDINAL,
+		&type, &format, &nitems, &extra, &p) == Success && p) {
+		if (nitems && format == 32)
+			d->counter = *(XSyncCounter *)p;
+		XFree(p);
+	}
+	if (!d->counter || !XSyncQueryCounter(dpy, d->counter, &d->value))
+		return;
+	attr.trigger.counter = d->counter;
+	attr.trigger.value_type = XSyncAbsolute;
+	attr.trigger.wait_value = d->value;
+	attr.trigger.test_type = XSyncPositiveComparison;
+	attr.events = True;
+	d->alarm = XSyncCreateAlarm(dpy, XSyncCACounter|XSyncCAValueType|XSyncCAValue
+		|XSyncCATestType|XSyncCAEvents, &attr);
+#endif /* XSYNC */
+}
+
+/* Asks the client to report when it has painted the size configured next. */
+void
+dragsync(Drag *d, Client *c)
+{
+#ifdef XSYNC
+	int overflow;
+	XEvent ev;
+	XSyncValue one;
+	XSyncAlarmAttributes attr;
+
+	if (!d->alarm)
+		return;
+	XSyncIntToValue(&one, 1);
+	XSyncValueAdd(&d->value, d->value, one, &overflow);
+	attr.trigger.wait_value = d->value;
+	XSyncChangeAlarm(dpy, d->alarm, XSyncCAValue, &attr);
+	ev.type = ClientMessage;
+	ev.xclient.window = c->win;
+	ev.xclient.message_type = wmatom[WMProtocols];
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = syncatom[0];
+	ev.xclient.data.l[1] = CurrentTime;
+	ev.xclient.data.l[2] = XSyncValueLow32(d->value);
+	ev.xclient.data.l[3] = XSyncValueHigh32(d->value);
+	ev.xclient.data.l[4] = 0;
+	XSendEvent(dpy, c->win, False, NoEventMask, &ev);
+	d->waiting = 1;
+	d->wait = d->now + 100000; /* 100ms */
+#endif /* XSYNC */
+}
+
 void
 drawbar(Monitor *m)
 {
-	int x, w, tw = 0;
+	drawbarparts(m, BarAll);
+}
+
+/* Draws the given regions of the bar of m and those marked dirty, and
+ * copies the span they cover to the window. The title follows a region
+ * that may have changed width; the status comes and goes with selmon,
+ * which then needs the whole bar. */
+void
+drawbarparts(Monitor *m, int parts)
+{
+	int x, w, tw = 0, lx = 0, x0, x1;
 	int boxs = drw->fonts->h / 9;
 	int boxw = drw->fonts->h / 6 + 2;
-	unsigned int i, occ = 0, urg = 0;
-	Client *c;
-
-	if (!m->showbar)
+	unsigned int i, occ, urg;
+
+	parts |= m->bardirty;
+	if (!m->bardrawn || m->barsel != (m == selmon))
+		parts = BarAll;
+	m->bardirty = 0;
+	m->barsel = m == selmon;
+	if (!m->showbar) {
+		m->bardrawn = 0; /* status and title may change meanwhile */
+		return;
+	}
+	if (!parts)
 		return;
+	if (parts & (BarLayout|BarStatus))
+		parts |= BarTitle;
+	drw_select(drw, m->barbuf);
+	for (i = 0; i < LENGTH(tags); i++)
+		lx += TEXTW(tags[i]);
+	blw = TEXTW(m->ltsymbol);
 
 	/* draw status first so it can be overdrawn by tags later */
 	if (m == selmon) { /* status is only drawn on selected monitor */
-		drw_setscheme(drw, scheme[SchemeNorm]);
-		tw = TEXTW(stext) - lrpad + 12; /* 12px right padding */
-		drw_text(drw, m->ww - tw - 2 * sp, 0, tw, bh, 6, stext, 0);
+		if (parts & BarStatus) {
+			m->bartw = TEXTW(stext) - lrpad + 12; /* 12px right padding */
+			drw_setscheme(drw, scheme[SchemeNorm]);
+			drw_text(drw, m->ww - m->bartw - 2 * sp, 0, m->bartw, bh, 6, stext, 0);
+			if (m->ww - m->bartw - 2 * sp < lx + blw)
+				parts = BarAll;
+		}
+		tw = m->bartw;
 	}
 
-	for (c = m->clients; c; c = c->next) {
-		occ |= c->tags;
-		if (c->isurgent)
-			urg |= c->tags;
-	}
+	occ = m->occ;
+	urg = m->urg;
 	x = 0;
-	for (i = 0; i < LENGTH(tags); i++) {
+	for (i = 0; parts & BarTags && i < LENGTH(tags); i++) {
 		w = TEXTW(tags[i]);
 		drw_setscheme(drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
 		drw_text(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
@@ -713,11 +1498,14 @@ drawbar(Monitor *m)
 				urg & 1 << i);
 		x += w;
 	}
-	w = blw = TEXTW(m->ltsymbol);
-	drw_setscheme(drw, scheme[SchemeNorm]);
-	x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+	x = lx;
+	if (parts & BarLayout) {
+		drw_setscheme(drw, scheme[SchemeNorm]);
+		drw_text(drw, x, 0, blw, bh, lrpad / 2, m->ltsymbol, 0);
+	}
+	x += blw;
 
-	if ((w = m->ww - tw - x) > bh) {
+	if (parts & BarTitle && (w = m->ww - tw - x) > bh) {
 		if (m->sel) {
 			drw_setscheme(drw, scheme[m == selmon ? SchemeSel : SchemeNorm]);
 			drw_text(drw, x, 0, w - 2 * sp, bh, lrpad / 2, m->sel->name, 0);
@@ -728,7 +1516,12 @@ drawbar(Monitor *m)
 			drw_rect(drw, x, 0, w - 2 * sp, bh, 1, 1);
 		}
 	}
-	drw_map(drw, m->barwin, 0, 0, m->ww, bh);
+	x0 = parts & BarTags ? 0 : parts & BarLayout ? lx : parts & BarTitle ? x : m->ww - tw - 2 * sp;
+	x1 = parts & BarStatus ? m->ww : parts & BarTitle ? m->ww - tw : parts & BarLayout ? x : lx;
+	x0 = MAX(x0, 0);
+	if (x1 > x0)
+		drw_map(drw, m->barwin, x0, 0, x1 - x0, bh);
+	m->bardrawn = 1;
 }
 
 void
@@ -740,6 +1533,16 @@ drawbars(void)
 		drawbar(m);
 }
 
+void
+drawdirtybars(void)
+{
+	Monitor *m;
+
+	for (m = mons; m; m = m->next)
+		if (m->bardirty)
+			drawbarparts(m, 0);
+}
+
 void
 enternotify(XEvent *e)
 {
@@ -759,19 +1562,105 @@ enternotify(XEvent *e)
 	focus(c);
 }
 
+#ifdef EVSTATS
+void
+evbegin(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &evt0);
+	evreq0 = NextRequest(dpy);
+}
+
+/* Writes the event loop statistics to stderr, dispatch times are read off
+ * the histogram and exact to 1 / 2^HISTSUB. */
+void
+evdump(void)
+{
+	static const double pct[] = { 50, 90, 99, 99.9, 100 };
+	unsigned long n = 0, seen, want;
+	unsigned int i, j;
+
+	evdumpreq = 0;
+	fprintf(stderr, "dwm: %-17s %10s %12s %10s %10s %8s\n",
+		"event", "count", "total us", "max us", "requests", "waits");
+	for (i = 0; i < LASTEvent; i++) {
+		if (!evstats[i].count)
+			continue;
+		n += evstats[i].count;
+		fprintf(stderr, "dwm: %-17s %10lu %12llu %10llu %10lu %8lu\n",
+			evnames[i] ? evnames[i] : "?", evstats[i].count,
+			evstats[i].ns / 1000, evstats[i].max / 1000,
+			evstats[i].requests, evstats[i].waits);
+	}
+	fprintf(stderr, "dwm: dispatch ns");
+	for (i = j = 0, seen = 0; n && j < LENGTH(pct); j++) {
+		want = (unsigned long)(n * pct[j] / 100);
+		for (; i < LENGTH(evhist) && seen + evhist[i] < MAX(want, 1); seen += evhist[i++]);
+		fprintf(stderr, " p%g<=%llu", pct[j], i < (1 << HISTSUB) ? (unsigned long long)i
+			: (unsigned long long)((1 << HISTSUB) + (i & ((1 << HISTSUB) - 1)) + 1)
+			<< ((i >> HISTSUB) - 1));
+	}
+	fputc('\n', stderr);
+}
+
+/* Accounts a dispatch started by evbegin(): waits counts dispatches that
+ * had to wait for the server to process a request of their own. */
+void
+evend(int type)
+{
+	struct timespec t1;
+	unsigned long long ns, v;
+	unsigned int e = 0, i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (t1.tv_sec - evt0.tv_sec) * 1000000000ULL + t1.tv_nsec - evt0.tv_nsec;
+	if (type >= LASTEvent)
+		type = 0;
+	evstats[type].count++;
+	evstats[type].ns += ns;
+	evstats[type].max = MAX(evstats[type].max, ns);
+	evstats[type].requests += NextRequest(dpy) - evreq0;
+	if (LastKnownRequestProcessed(dpy) >= evreq0)
+		evstats[type].waits++;
+	/* log-linear bucket: exponent above HISTSUB, then HISTSUB bits */
+	for (v = ns >> HISTSUB; v; v >>= 1)
+		e++;
+	i = e ? (e << HISTSUB) + ((ns >> (e - 1)) & ((1 << HISTSUB) - 1)) : ns;
+	evhist[i]++;
+}
+#endif /* EVSTATS */
+
 void
 expose(XEvent *e)
 {
 	Monitor *m;
 	XExposeEvent *ev = &e->xexpose;
 
-	if (ev->count == 0 && (m = wintomon(ev->window)))
+	if (!(m = wintomon(ev->window)))
+		return;
+	/* the back buffer still holds the bar, copy the exposed part */
+	if (m->bardrawn) {
+		drw_select(drw, m->barbuf);
+		drw_map(drw, m->barwin, ev->x, ev->y, ev->width, ev->height);
+	} else if (ev->count == 0)
 		drawbar(m);
 }
 
+/* Tells whether func acts outside of dwm: runs a program, kills a client
+ * or ends dwm. A replay does not do these. */
+int
+external(void (*func)(const Arg *))
+{
+	return func == spawn || func == quit || func == killclient
+		|| func == kblayout || func == setbright || func == setvolume;
+}
+
 void
 focus(Client *c)
 {
+	static Window lastwin;
+	static int lastmon = -1; /* by number, a freed monitor's address may come back */
+	Monitor *m;
+
 	if (!c || !ISVISIBLE(c))
 		for (c = selmon->stack; c && !ISVISIBLE(c); c = c->snext);
 	if (selmon->sel && selmon->sel != c)
@@ -791,7 +1680,16 @@ focus(Client *c)
 		XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
 	}
 	selmon->sel = c;
-	drawbars();
+	/* only the bars of the old and the new selected monitor change, the
+	 * title and the tag of the selected client within them */
+	for (m = mons; m; m = m->next)
+		if (m == selmon || m->barsel)
+			dirtybar(m, BarTags|BarTitle);
+	if (selmon->num != lastmon || (c ? c->win : None) != lastwin) {
+		lastmon = selmon->num;
+		lastwin = c ? c->win : None;
+		ipcevent(IpcEvFocus, selmon, c, NULL);
+	}
 }
 
 /* there are some broken focus acquiring clients needing extra handling */
@@ -821,38 +1719,47 @@ focusmon(const Arg *arg)
 void
 focusstack(const Arg *arg)
 {
-	Client *c = NULL, *i;
+	int i, n;
+	Client *c;
 
 	if (!selmon->sel || (selmon->sel->isfullscreen && lockfullscreen))
 		return;
-	if (arg->i > 0) {
-		for (c = selmon->sel->next; c && !ISVISIBLE(c); c = c->next);
-		if (!c)
-			for (c = selmon->clients; c && !ISVISIBLE(c); c = c->next);
-	} else {
-		for (i = selmon->clients; i != selmon->sel; i = i->next)
-			if (ISVISIBLE(i))
-				c = i;
-		if (!c)
-			for (; i; i = i->next)
-				if (ISVISIBLE(i))
-					c = i;
-	}
-	if (c) {
-		focus(c);
-		restack(selmon);
-	}
+	updatetiled(selmon);
+	if (!(n = selmon->nvisible))
+		return;
+	for (i = 0; i < n && selmon->visible[i] != selmon->sel; i++);
+	if (i == n)
+		c = selmon->visible[arg->i > 0 ? 0 : n - 1];
+	else
+		c = selmon->visible[(i + (arg->i > 0 ? 1 : n - 1)) % n];
+	focus(c);
+	restack(selmon);
+}
+
+/* Makes room for the layout of n clients. */
+void
+geomalloc(int n)
+{
+	if (n <= geomsize)
+		return;
+	geomsize = n + 16;
+	free(geom);
+	free(geombw);
+	free(geomhints);
+	geom = ecalloc(geomsize, sizeof(Rect));
+	geombw = ecalloc(geomsize, sizeof(int));
+	geomhints = ecalloc(geomsize, sizeof(Hints *));
 }
 
 Atom
-getatomprop(Client *c, Atom prop)
+getatomprop(Window w, Atom prop)
 {
 	int di;
 	unsigned long dl;
 	unsigned char *p = NULL;
 	Atom da, atom = None;
 
-	if (XGetWindowProperty(dpy, c->win, prop, 0L, sizeof atom, False, XA_ATOM,
+	if (XGetWindowProperty(dpy, w, prop, 0L, sizeof atom, False, XA_ATOM,
 		&da, &di, &dl, &dl, &p) == Success && p) {
 		atom = *(Atom *)p;
 		XFree(p);
@@ -860,6 +1767,34 @@ getatomprop(Client *c, Atom prop)
 	return atom;
 }
 
+void
+getprops(Window w, Props *p)
+{
+	long msize;
+	XWMHints *wmh;
+	XClassHint ch;
+
+	p->namelen = gettitle(w, p->name);
+	if (XGetClassHint(dpy, w, &ch)) {
+		classcpy(p->instance, ch.res_name ? ch.res_name : "", -1);
+		classcpy(p->class, ch.res_class ? ch.res_class : "", -1);
+		XFree(ch.res_name);
+		XFree(ch.res_class);
+	} else
+		p->instance[0] = p->class[0] = '\0';
+	if (!XGetTransientForHint(dpy, w, &p->trans))
+		p->trans = None;
+	p->state = getatomprop(w, netatom[NetWMState]);
+	p->wtype = getatomprop(w, netatom[NetWMWindowType]);
+	if (!XGetWMNormalHints(dpy, w, &p->size, &msize))
+		p->size.flags = 0;
+	if ((wmh = XGetWMHints(dpy, w))) {
+		p->wmh = *wmh;
+		XFree(wmh);
+	} else
+		p->wmh.flags = 0;
+}
+
 int
 getrootptr(int *x, int *y)
 {
@@ -870,6 +1805,7 @@ getrootptr(int *x, int *y)
 	return XQueryPointer(dpy, root, &dummy, &dummy, x, y, &di, &di, &dui);
 }
 
+#ifndef XCB
 long
 getstate(Window w)
 {
@@ -887,6 +1823,7 @@ getstate(Window w)
 	XFree(p);
 	return result;
 }
+#endif /* XCB */
 
 int
 gettextprop(Window w, Atom atom, char *text, unsigned int size)
@@ -913,53 +1850,89 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 	return 1;
 }
 
+/* Reads the title of w into name (TITLEMAX bytes) as UTF-8 and returns its
+ * length. _NET_WM_NAME is fetched as UTF8_STRING and used as is, only a
+ * WM_NAME in compound text goes through Xlib's conversion. */
+unsigned int
+gettitle(Window w, char *name)
+{
+	int format, n;
+	unsigned int len = 0;
+	unsigned long nitems, extra;
+	unsigned char *p = NULL;
+	char **list = NULL;
+	Atom type;
+	XTextProperty prop;
+
+	if (XGetWindowProperty(dpy, w, netatom[NetWMName], 0L, TITLEMAX / 4, False,
+		utf8string, &type, &format, &nitems, &extra, &p) == Success && p) {
+		if (type == utf8string && format == 8)
+			len = titlecpy(name, p, nitems, 0);
+		XFree(p);
+	}
+	if (!len && XGetTextProperty(dpy, w, &prop, XA_WM_NAME) && prop.value) {
+		if (prop.encoding == XA_STRING || prop.encoding == utf8string)
+			len = titlecpy(name, prop.value, prop.nitems, prop.encoding == XA_STRING);
+		else if (Xutf8TextPropertyToTextList(dpy, &prop, &list, &n) >= Success && n > 0 && *list) {
+			len = titlecpy(name, (unsigned char *)*list, strlen(*list), 0);
+			XFreeStringList(list);
+		}
+		XFree(prop.value);
+	}
+	if (!len) /* hack to mark broken clients */
+		len = titlecpy(name, (unsigned char *)broken, sizeof broken - 1, 0);
+	return len;
+}
+
+/* Switches the client to its focused or unfocused set of button grabs,
+ * nothing is sent if it already has that set. The unfocused set catches any
+ * click to focus the client; it has to be grabbed before the client buttons
+ * so that those take precedence, hence each switch grabs the set anew. */
 void
 grabbuttons(Client *c, int focused)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
-		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
-		if (!focused)
-			XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
-				BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
-		for (i = 0; i < LENGTH(buttons); i++)
-			if (buttons[i].click == ClkClientWin)
-				for (j = 0; j < LENGTH(modifiers); j++)
-					XGrabButton(dpy, buttons[i].button,
-						buttons[i].mask | modifiers[j],
-						c->win, False, BUTTONMASK,
-						GrabModeAsync, GrabModeSync, None, None);
-	}
+	unsigned int i, j;
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+
+	if (c->grabs == (focused ? GrabFocused : GrabUnfocused))
+		return;
+	c->grabs = focused ? GrabFocused : GrabUnfocused;
+	XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
+	if (!focused)
+		XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
+			BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
+	for (i = 0; i < LENGTH(buttons); i++)
+		if (buttons[i].click == ClkClientWin)
+			for (j = 0; j < LENGTH(modifiers); j++)
+				XGrabButton(dpy, buttons[i].button,
+					buttons[i].mask | modifiers[j],
+					c->win, False, BUTTONMASK,
+					GrabModeAsync, GrabModeSync, None, None);
 }
 
 void
 grabkeys(void)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
-		KeyCode code;
+	unsigned int i, j;
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	KeyCode code;
 
-		XUngrabKey(dpy, AnyKey, AnyModifier, root);
-		for (i = 0; i < LENGTH(keys); i++)
-			if ((code = XKeysymToKeycode(dpy, keys[i].keysym)))
-				for (j = 0; j < LENGTH(modifiers); j++)
-					XGrabKey(dpy, code, keys[i].mod | modifiers[j], root,
-						True, GrabModeAsync, GrabModeAsync);
-	}
+	XUngrabKey(dpy, AnyKey, AnyModifier, root);
+	for (i = 0; i < LENGTH(keys); i++)
+		if ((code = XKeysymToKeycode(dpy, keys[i].keysym)))
+			for (j = 0; j < LENGTH(modifiers); j++)
+				XGrabKey(dpy, code, keys[i].mod | modifiers[j], root,
+					True, GrabModeAsync, GrabModeAsync);
 }
 
 int client_count() {
-	int count = 0;
-
-	for (Client* c = selmon -> clients; c; c = c -> next) {
-		count++;
-	}
+	return selmon->nclients;
+}
 
-	return count;
+void
+grid(Monitor *m)
+{
+	arrangetiled(m, lt_grid);
 }
 
 void
@@ -969,6 +1942,209 @@ incnmaster(const Arg *arg)
 	arrange(selmon);
 }
 
+/* Pushes an event to the subscribers of its class, the JSON is only built
+ * if there is at least one. */
+void
+ipcevent(int ev, Monitor *m, Client *c, const char *action)
+{
+	static IpcBuf b;
+
+	if (!ipc_subscribed(ipc, 1 << ev))
+		return;
+	b.len = 0;
+	ipc_buf_printf(&b, "{\"event\":\"%s\",\"monitor\":%d", ipcevnames[ev], m->num);
+	switch (ev) {
+	case IpcEvFocus:
+		ipc_buf_printf(&b, ",\"win\":%lu", c ? c->win : 0);
+		break;
+	case IpcEvTag:
+		ipc_buf_printf(&b, ",\"tagset\":%u", m->tagset[m->seltags]);
+		break;
+	case IpcEvLayout:
+		ipc_buf_printf(&b, ",\"layout\":%d,\"ltsymbol\":",
+			(int)(m->lt[m->sellt] - layouts));
+		ipc_buf_str(&b, m->ltsymbol);
+		break;
+	case IpcEvClient:
+		ipc_buf_printf(&b, ",\"action\":\"%s\",\"win\":%lu", action, c->win);
+		break;
+	}
+	ipc_buf_printf(&b, "}\n");
+	ipc_event(ipc, 1 << ev, b.data, b.len);
+}
+
+void
+ipcmessage(IpcClient *ic, char *msg)
+{
+	char *val, *end;
+	const char *err = NULL;
+	unsigned int i;
+	long l;
+	Arg arg = {0};
+	IpcBuf b = {0};
+
+	for (val = msg; *val && *val != ' '; val++);
+	if (*val)
+		*val++ = '\0';
+	while (*val == ' ')
+		val++;
+
+	if (!strcmp(msg, "get_state") || !strcmp(msg, "get_stats")) {
+		if (!strcmp(msg, "get_state"))
+			ipcstate(&b);
+		else
+			ipcstats(&b);
+		ipc_buf_printf(&b, "\n");
+		ipc_send(ic, b.data, b.len);
+		ipc_buf_free(&b);
+		return;
+	}
+	for (i = 0; i < LENGTH(ipccommands) && strcmp(msg, ipccommands[i].name); i++);
+	if (!strcmp(msg, "subscribe") || !strcmp(msg, "unsubscribe")) {
+		err = ipcsubscribe(ic, msg[0] == 's', val);
+	} else if (i == LENGTH(ipccommands)) {
+		err = "unknown command";
+	} else {
+		errno = 0;
+		end = val;
+		switch (ipccommands[i].argtype) {
+		case IpcArgInt:
+			arg.i = strtol(val, &end, 0);
+			break;
+		case IpcArgUint:
+			arg.ui = strtoul(val, &end, 0);
+			break;
+		case IpcArgFloat:
+			arg.f = strtof(val, &end);
+			break;
+		case IpcArgLayout:
+			if (!*val)
+				break;
+			l = strtol(val, &end, 0);
+			if (l >= 0 && l < LENGTH(layouts))
+				arg.v = &layouts[l];
+			else
+				errno = ERANGE;
+			break;
+		}
+		if (*end || errno)
+			err = "invalid argument";
+		else
+			ipccommands[i].func(&arg);
+	}
+	if (err)
+		ipc_buf_printf(&b, "{\"ok\":false,\"error\":\"%s\"}\n", err);
+	else
+		ipc_buf_printf(&b, "{\"ok\":true}\n");
+	ipc_send(ic, b.data, b.len);
+	ipc_buf_free(&b);
+}
+
+/* Returns ipcsockpath or, where it is empty, a path in $XDG_RUNTIME_DIR
+ * named after the display, so users and displays never share a socket. */
+const char *
+ipcpath(void)
+{
+	static char path[256];
+	const char *dir;
+	char *p;
+
+	if (!ipcsockpath || *ipcsockpath)
+		return ipcsockpath;
+	if (!(dir = getenv("XDG_RUNTIME_DIR")) || !*dir) {
+		fputs("dwm: XDG_RUNTIME_DIR is not set, no ipc socket\n", stderr);
+		return NULL;
+	}
+	snprintf(path, sizeof(path), "%s/dwm-%s.sock", dir, DisplayString(dpy));
+	for (p = path + strlen(dir) + 1; *p; p++)
+		if (*p == '/')
+			*p = '_';
+	return path;
+}
+
+/* Serializes monitors, tags, layouts and clients as one compact JSON object. */
+void
+ipcstate(IpcBuf *b)
+{
+	unsigned int i;
+	Client *c;
+	Monitor *m;
+
+	ipc_buf_printf(b, "{\"tags\":[");
+	for (i = 0; i < LENGTH(tags); i++) {
+		ipc_buf_printf(b, "%s", i ? "," : "");
+		ipc_buf_str(b, tags[i]);
+	}
+	ipc_buf_printf(b, "],\"layouts\":[");
+	for (i = 0; i < LENGTH(layouts); i++) {
+		ipc_buf_printf(b, "%s", i ? "," : "");
+		ipc_buf_str(b, layouts[i].symbol);
+	}
+	ipc_buf_printf(b, "],\"selmon\":%d,\"monitors\":[", selmon->num);
+	for (m = mons; m; m = m->next) {
+		ipc_buf_printf(b, "%s{\"num\":%d,\"name\":", m == mons ? "" : ",", m->num);
+		ipc_buf_str(b, m->name);
+		ipc_buf_printf(b, ",\"refresh\":%d,\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d,"
+			"\"wx\":%d,\"wy\":%d,\"ww\":%d,\"wh\":%d,\"tagset\":%u,"
+			"\"layout\":%d,\"ltsymbol\":",
+			m->refresh, m->mx, m->my, m->mw, m->mh,
+			m->wx, m->wy, m->ww, m->wh, m->tagset[m->seltags],
+			(int)(m->lt[m->sellt] - layouts));
+		ipc_buf_str(b, m->ltsymbol);
+		ipc_buf_printf(b, ",\"mfact\":%.2f,\"nmaster\":%d,\"gap\":%d,"
+			"\"showbar\":%d,\"sel\":%lu,\"clients\":[",
+			m->mfact, m->nmaster, m->gap->gappx, m->showbar,
+			m->sel ? m->sel->win : 0);
+		for (c = m->clients; c; c = c->next) {
+			ipc_buf_printf(b, "%s{\"win\":%lu,\"name\":",
+				c == m->clients ? "" : ",", c->win);
+			ipc_buf_str(b, c->name);
+			ipc_buf_printf(b, ",\"tags\":%u,\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d,"
+				"\"bw\":%d,\"floating\":%d,\"fullscreen\":%d,\"urgent\":%d}",
+				c->tags, c->x, c->y, c->w, c->h, c->bw,
+				c->isfloating, c->isfullscreen, c->isurgent);
+		}
+		ipc_buf_printf(b, "]}");
+	}
+	ipc_buf_printf(b, "]}");
+}
+
+/* Counters for checking what the window manager spends its time on. */
+void
+ipcstats(IpcBuf *b)
+{
+	ipc_buf_printf(b, "{\"motion\":{\"events\":%lu,\"coalesced\":%lu,\"lookups\":%lu}",
+		motionevents, motioncoalesced, motionlookups);
+	ipc_buf_printf(b, ",\"arrange\":{\"performed\":%lu,\"skipped\":%lu}",
+		arrangeruns, arrangeskips);
+	/* the request count is Xlib's sequence number */
+	ipc_buf_printf(b, ",\"x\":{\"events\":%lu,\"requests\":%lu,\"idles\":%lu}}",
+		xevents, XNextRequest(dpy) - 1, xidles);
+}
+
+/* val is a space separated list of event class names or "all" */
+const char *
+ipcsubscribe(IpcClient *ic, int on, char *val)
+{
+	char *name;
+	unsigned int i, subs = 0;
+
+	for (name = strtok(val, " "); name; name = strtok(NULL, " ")) {
+		if (!strcmp(name, "all")) {
+			subs |= (1 << IpcEvLast) - 1;
+			continue;
+		}
+		for (i = 0; i < IpcEvLast && strcmp(name, ipcevnames[i]); i++);
+		if (i == IpcEvLast)
+			return "unknown event";
+		subs |= 1 << i;
+	}
+	if (!subs)
+		return "no event given";
+	ipc_subscribe(ic, on ? ic->subs | subs : ic->subs & ~subs);
+	return NULL;
+}
+
 #ifdef XINERAMA
 static int
 isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
@@ -993,7 +2169,7 @@ keypress(XEvent *e)
 	for (i = 0; i < LENGTH(keys); i++)
 		if (keysym == keys[i].keysym
 		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
-		&& keys[i].func)
+		&& keys[i].func && !(tracein && external(keys[i].func)))
 			keys[i].func(&(keys[i].arg));
 }
 
@@ -1014,13 +2190,12 @@ killclient(const Arg *arg)
 }
 
 void
-manage(Window w, XWindowAttributes *wa)
+manage(Window w, XWindowAttributes *wa, Props *p)
 {
 	Client *c, *t = NULL;
-	Window trans = None;
 	XWindowChanges wc;
 
-	c = ecalloc(1, sizeof(Client));
+	c = pool_alloc(&clientpool);
 	c->win = w;
 	/* geometry */
 	c->x = c->oldx = wa->x;
@@ -1029,12 +2204,13 @@ manage(Window w, XWindowAttributes *wa)
 	c->h = c->oldh = wa->height;
 	c->oldbw = wa->border_width;
 
-	updatetitle(c);
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
+	settitle(c, p->name, p->namelen);
+	if (p->trans != None && (t = wintoclient(p->trans))) {
 		c->mon = t->mon;
 		c->tags = t->tags;
 	} else {
 		c->mon = selmon;
+		applyrules(c, p);
 		c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
 	}
 
@@ -1052,93 +2228,121 @@ manage(Window w, XWindowAttributes *wa)
 	XConfigureWindow(dpy, w, CWBorderWidth, &wc);
 	XSetWindowBorder(dpy, w, scheme[SchemeNorm][ColBorder].pixel);
 	configure(c); /* propagates border_width, if size doesn't change */
-	updatewindowtype(c);
-	updatesizehints(c);
-	updatewmhints(c);
-	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
+	setwindowtype(c, p->state, p->wtype);
+	setsizehints(c, &p->size);
+	XSelectInput(dpy, w, CLIENTMASK);
 	grabbuttons(c, 0);
 	if (!c->isfloating)
-		c->isfloating = c->oldstate = trans != None || c->isfixed;
+		c->isfloating = c->oldstate = p->trans != None || c->isfixed;
 	if (c->isfloating)
 		XRaiseWindow(dpy, c->win);
 	attach(c);
 	attachstack(c);
-	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
-		(unsigned char *) &(c->win), 1);
+	tagcount(c, 1);
+	c->mon->last.valid = 0; /* may reuse the place of an unmanaged client */
+	setwmhints(c, &p->wmh);
+	ipcevent(IpcEvClient, c->mon, c, "add");
+	updateclientlist(c->win, 1);
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
 	setclientstate(c, NormalState);
 	if (c->mon == selmon)
 		unfocus(selmon->sel, 0);
 	c->mon->sel = c;
+	if (scanning) { /* scan() arranges once all windows are adopted */
+		XMapWindow(dpy, c->win);
+		return;
+	}
 	arrange(c->mon);
-	XMapWindow(dpy, c->win);
+	if (!c->hidden)
+		XMapWindow(dpy, c->win);
 	focus(NULL);
 }
 
 void
 mappingnotify(XEvent *e)
 {
+	Client *c;
+	Monitor *m;
 	XMappingEvent *ev = &e->xmapping;
 
 	XRefreshKeyboardMapping(ev);
-	if (ev->request == MappingKeyboard)
-		grabkeys();
+	if (ev->request != MappingKeyboard && ev->request != MappingModifier)
+		return;
+	/* the modifier state is only queried here and in setup() */
+	updatenumlockmask();
+	grabkeys();
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next) {
+			c->grabs = GrabNone;
+			grabbuttons(c, m == selmon && c == m->sel);
+		}
 }
 
 void
 maprequest(XEvent *e)
 {
 	static XWindowAttributes wa;
+	static Props p;
 	XMapRequestEvent *ev = &e->xmaprequest;
 
 	if (!XGetWindowAttributes(dpy, ev->window, &wa))
 		return;
 	if (wa.override_redirect)
 		return;
-	if (!wintoclient(ev->window))
-		manage(ev->window, &wa);
+	if (!wintoclient(ev->window)) {
+		getprops(ev->window, &p);
+		manage(ev->window, &wa, &p);
+	}
 }
 
 void
 monocle(Monitor *m)
 {
-	unsigned int n = 0;
-	Client *c;
-
-	for (c = m->clients; c; c = c->next)
-		if (ISVISIBLE(c))
-			n++;
-	if (n > 0) /* override layout symbol */
-		snprintf(m->ltsymbol, sizeof m->ltsymbol, "[%d]", n);
-	for (c = nexttiled(m->clients); c; c = nexttiled(c->next))
-		resize(c, m->wx, m->wy, m->ww - 2 * c->bw, m->wh - 2 * c->bw, 0);
+	updatetiled(m);
+	if (m->nvisible > 0) /* override layout symbol */
+		snprintf(m->ltsymbol, sizeof m->ltsymbol, "[%d]", m->nvisible);
+	arrangetiled(m, lt_monocle);
 }
 
 void
 motionnotify(XEvent *e)
 {
-	static Monitor *mon = NULL;
 	Monitor *m;
+	XEvent next;
 	XMotionEvent *ev = &e->xmotion;
 
 	if (ev->window != root)
 		return;
-	if ((m = recttomon(ev->x_root, ev->y_root, 1, 1)) != mon && mon) {
+	motionevents++;
+	/* of consecutive root motion only the last position matters */
+	while (QLength(dpy)) {
+		XPeekEvent(dpy, &next);
+		if (next.type != MotionNotify || next.xmotion.window != root)
+			break;
+		XNextEvent(dpy, e);
+		if (traceout)
+			tracewrite(e, TRACEMERGED);
+		motionevents++;
+		motioncoalesced++;
+	}
+	if (ptrmon && INSIDE(ev->x_root, ev->y_root, ptrmon))
+		return;
+	motionlookups++;
+	if ((m = pointtomon(ev->x_root, ev->y_root)) != ptrmon && ptrmon) {
 		unfocus(selmon->sel, 1);
 		selmon = m;
 		focus(NULL);
 	}
-	mon = m;
+	ptrmon = m;
 }
 
 void
 movemouse(const Arg *arg)
 {
-	int x, y, ocx, ocy, nx, ny;
+	int x, y, ocx, ocy, nx, ny, nw, nh;
 	Client *c;
 	Monitor *m;
-	XEvent ev;
-	Time lasttime = 0;
+	Drag d;
 
 	if (!(c = selmon->sel))
 		return;
@@ -1152,37 +2356,28 @@ movemouse(const Arg *arg)
 		return;
 	if (!getrootptr(&x, &y))
 		return;
-	do {
-		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
-		switch(ev.type) {
-		case ConfigureRequest:
-		case Expose:
-		case MapRequest:
-			handler[ev.type](&ev);
-			break;
-		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nx = ocx + (ev.xmotion.x - x);
-			ny = ocy + (ev.xmotion.y - y);
-			if (abs(selmon->wx - nx) < snap)
-				nx = selmon->wx;
-			else if (abs((selmon->wx + selmon->ww) - (nx + WIDTH(c))) < snap)
-				nx = selmon->wx + selmon->ww - WIDTH(c);
-			if (abs(selmon->wy - ny) < snap)
-				ny = selmon->wy;
-			else if (abs((selmon->wy + selmon->wh) - (ny + HEIGHT(c))) < snap)
-				ny = selmon->wy + selmon->wh - HEIGHT(c);
-			if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
-			&& (abs(nx - c->x) > snap || abs(ny - c->y) > snap))
-				togglefloating(NULL);
-			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
-				resize(c, nx, ny, c->w, c->h, 1);
-			break;
-		}
-	} while (ev.type != ButtonRelease);
+	dragstart(&d, c, 0);
+	while (dragnext(&d)) {
+		nx = ocx + (d.x - x);
+		ny = ocy + (d.y - y);
+		if (abs(selmon->wx - nx) < snap)
+			nx = selmon->wx;
+		else if (abs((selmon->wx + selmon->ww) - (nx + WIDTH(c))) < snap)
+			nx = selmon->wx + selmon->ww - WIDTH(c);
+		if (abs(selmon->wy - ny) < snap)
+			ny = selmon->wy;
+		else if (abs((selmon->wy + selmon->wh) - (ny + HEIGHT(c))) < snap)
+			ny = selmon->wy + selmon->wh - HEIGHT(c);
+		if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
+		&& (abs(nx - c->x) > snap || abs(ny - c->y) > snap))
+			togglefloating(NULL);
+		nw = c->w;
+		nh = c->h;
+		if ((!selmon->lt[selmon->sellt]->arrange || c->isfloating)
+		&& applysizehints(c, &nx, &ny, &nw, &nh, 1))
+			dragplace(c, nx, ny, nw, nh);
+	}
+	dragend(&d);
 	XUngrabPointer(dpy, CurrentTime);
 	if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
 		sendmon(c, m);
@@ -1198,6 +2393,42 @@ nexttiled(Client *c)
 	return c;
 }
 
+/* Like resizeclient(), but leaves syncing to the caller. */
+void
+placeclient(Client *c, int x, int y, int w, int h)
+{
+	XWindowChanges wc;
+
+	c->oldx = c->x; c->x = wc.x = x;
+	c->oldy = c->y; c->y = wc.y = y;
+	c->oldw = c->w; c->w = wc.width = w;
+	c->oldh = c->h; c->h = wc.height = h;
+	wc.border_width = c->bw;
+	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
+	winmoved = 1;
+	configure(c);
+}
+
+/* Like recttomon() for a single point, but only tests the monitors whose
+ * left edge is close enough to the left of x. */
+Monitor *
+pointtomon(int x, int y)
+{
+	int i, lo = 0, hi = nmonindex;
+
+	while (lo < hi) {
+		i = (lo + hi) / 2;
+		if (monindex[i]->wx <= x)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	for (i = lo - 1; i >= 0 && monindex[i]->wx + monindexw > x; i--)
+		if (INSIDE(x, y, monindex[i]))
+			return monindex[i];
+	return selmon;
+}
+
 void
 pop(Client *c)
 {
@@ -1209,12 +2440,11 @@ pop(Client *c)
 
 Client *
 prevtiled(Client *c) {
-	Client *p, *r;
+	int i;
 
-	for(p = selmon->clients, r = NULL; p && p != c; p = p->next)
-		if(!p->isfloating && ISVISIBLE(p))
-			r = p;
-	return r;
+	updatetiled(selmon);
+	for(i = 0; i < selmon->ntiled && selmon->tiled[i] != c; i++);
+	return i ? selmon->tiled[i - 1] : NULL;
 }
 
 void
@@ -1233,8 +2463,10 @@ propertynotify(XEvent *e)
 		default: break;
 		case XA_WM_TRANSIENT_FOR:
 			if (!c->isfloating && (XGetTransientForHint(dpy, c->win, &trans)) &&
-				(c->isfloating = (wintoclient(trans)) != NULL))
+				(c->isfloating = (wintoclient(trans)) != NULL)) {
+				c->mon->tiledstale = 1;
 				arrange(c->mon);
+			}
 			break;
 		case XA_WM_NORMAL_HINTS:
 			updatesizehints(c);
@@ -1244,11 +2476,9 @@ propertynotify(XEvent *e)
 			drawbars();
 			break;
 		}
-		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
-			updatetitle(c);
-			if (c == c->mon->sel)
-				drawbar(c->mon);
-		}
+		if ((ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName])
+		&& updatetitle(c) && c == c->mon->sel)
+			dirtybar(c->mon, BarTitle);
 		if (ev->atom == netatom[NetWMWindowType])
 			updatewindowtype(c);
 	}
@@ -1260,14 +2490,9 @@ pushdown(const Arg *arg) {
 
 	if(!sel || sel->isfloating)
 		return;
-	if((c = nexttiled(sel->next))) {
-		detach(sel);
-		sel->next = c->next;
-		c->next = sel;
-	} else {
-		detach(sel);
-		attach(sel);
-	}
+	c = nexttiled(sel->next);
+	detach(sel);
+	attachafter(sel, c);
 	focus(sel);
 	arrange(selmon);
 }
@@ -1278,20 +2503,13 @@ pushup(const Arg *arg) {
 
 	if(!sel || sel->isfloating)
 		return;
-	if((c = prevtiled(sel))) {
-		detach(sel);
-		sel->next = c;
-		if(selmon->clients == c)
-			selmon->clients = sel;
-		else {
-			for(c = selmon->clients; c->next != sel->next; c = c->next);
-			c->next = sel;
-		}
-	} else {
+	if((c = prevtiled(sel)))
+		c = c->prev;
+	else /* wrap around to the end */
 		for(c = sel; c->next; c = c->next);
+	if(c != sel) {
 		detach(sel);
-		sel->next = NULL;
-		c->next = sel;
+		attachafter(sel, c);
 	}
 	focus(sel);
 	arrange(selmon);
@@ -1303,6 +2521,164 @@ quit(const Arg *arg)
 	running = 0;
 }
 
+#ifdef XRANDR
+static int
+randrrefresh(XRRScreenResources *res, XRRMonitorInfo *info)
+{
+	int i, rate = 0;
+	unsigned int vtotal;
+	XRROutputInfo *oi;
+	XRRCrtcInfo *ci = NULL;
+	XRRModeInfo *mi;
+
+	if (!info->noutput || !(oi = XRRGetOutputInfo(dpy, res, info->outputs[0])))
+		return 0;
+	if (oi->crtc)
+		ci = XRRGetCrtcInfo(dpy, res, oi->crtc);
+	XRRFreeOutputInfo(oi);
+	if (!ci)
+		return 0;
+	for (i = 0; i < res->nmode; i++) {
+		mi = &res->modes[i];
+		if (mi->id != ci->mode || !mi->hTotal || !mi->vTotal)
+			continue;
+		vtotal = mi->vTotal;
+		if (mi->modeFlags & RR_DoubleScan)
+			vtotal *= 2;
+		if (mi->modeFlags & RR_Interlace)
+			vtotal /= 2;
+		rate = (int)((double)mi->dotClock / ((double)mi->hTotal * vtotal) + 0.5);
+		break;
+	}
+	XRRFreeCrtcInfo(ci);
+	return rate;
+}
+
+/* Matches the RandR monitors to ours by name first, so that hot-plugging
+ * one output leaves the others, and the clients on them, where they are.
+ * Returns -1 if RandR reports no monitors. */
+static int
+randrgeom(void)
+{
+	int i, j, k, n, dirty = 0;
+	char *name;
+	Client *c;
+	Monitor *m, *next, *keep, **match;
+	XRRMonitorInfo *info;
+	XRRScreenResources *res;
+
+	if (!(info = XRRGetMonitors(dpy, root, True, &n)) || n <= 0) {
+		if (info)
+			XRRFreeMonitors(info);
+		return -1;
+	}
+	/* only consider unique geometries as separate screens */
+	for (i = 0, j = 0; i < n; i++) {
+		for (k = 0; k < j; k++)
+			if (info[k].x == info[i].x && info[k].y == info[i].y
+			&& info[k].width == info[i].width && info[k].height == info[i].height)
+				break;
+		if (k == j)
+			info[j++] = info[i];
+	}
+	n = j;
+	match = ecalloc(n, sizeof(Monitor *));
+	for (i = 0; i < n; i++)
+		for (m = mons; m; m = m->next)
+			if (m->output == info[i].name)
+				match[i] = m;
+	/* left over monitors are reused before new ones are created */
+	for (i = 0, m = mons; i < n; i++) {
+		if (match[i])
+			continue;
+		for (; m; m = m->next) {
+			for (j = 0; j < n && match[j] != m; j++);
+			if (j == n)
+				break;
+		}
+		if (!(match[i] = m)) {
+			for (m = mons; m && m->next; m = m->next);
+			if (m)
+				m = m->next = createmon();
+			else
+				m = mons = createmon();
+			match[i] = m;
+			m = NULL;
+		}
+	}
+	res = XRRGetScreenResourcesCurrent(dpy, root);
+	for (i = 0; i < n; i++) {
+		m = match[i];
+		m->num = i;
+		if (m->output != info[i].name) {
+			m->output = info[i].name;
+			if ((name = XGetAtomName(dpy, m->output))) {
+				strncpy(m->name, name, sizeof m->name - 1);
+				XFree(name);
+			}
+		}
+		if (res)
+			m->refresh = randrrefresh(res, &info[i]);
+		if (info[i].x != m->mx || info[i].y != m->my
+		|| info[i].width != m->mw || info[i].height != m->mh)
+		{
+			dirty = 1;
+			m->mx = m->wx = info[i].x;
+			m->my = m->wy = info[i].y;
+			m->mw = m->ww = info[i].width;
+			m->mh = m->wh = info[i].height;
+			updatebarpos(m);
+		}
+	}
+	if (res)
+		XRRFreeScreenResources(res);
+	/* clients of vanished monitors move to the first one left */
+	keep = match[0];
+	for (m = mons; m; m = next) {
+		next = m->next;
+		for (j = 0; j < n && match[j] != m; j++);
+		if (j < n)
+			continue;
+		while ((c = m->clients)) {
+			dirty = 1;
+			detach(c);
+			detachstack(c);
+			c->mon = keep;
+			attach(c);
+			attachstack(c);
+			tagcount(c, 1);
+		}
+		if (m == selmon)
+			selmon = keep;
+		cleanupmon(m);
+	}
+	/* the list follows the numbers, dirtomon() and others rely on it */
+	for (i = 0; i < n; i++)
+		match[i]->next = i + 1 < n ? match[i + 1] : NULL;
+	mons = match[0];
+	free(match);
+	XRRFreeMonitors(info);
+	return dirty;
+}
+
+static void
+randrnotify(XEvent *e)
+{
+	XEvent ev;
+	int dirty;
+
+	XRRUpdateConfiguration(e);
+	/* a hot-plug comes as a burst of notifications, handle them at once */
+	while (XCheckTypedEvent(dpy, randrevbase + RRScreenChangeNotify, &ev)
+	|| XCheckTypedEvent(dpy, randrevbase + RRNotify, &ev))
+		XRRUpdateConfiguration(&ev);
+	dirty = sw != DisplayWidth(dpy, screen) || sh != DisplayHeight(dpy, screen);
+	sw = DisplayWidth(dpy, screen);
+	sh = DisplayHeight(dpy, screen);
+	rescreen(dirty);
+}
+#endif /* XRANDR */
+
 Monitor *
 recttomon(int x, int y, int w, int h)
 {
@@ -1317,6 +2693,126 @@ recttomon(int x, int y, int w, int h)
 	return r;
 }
 
+/* Feeds the events of a trace written with -r to the handlers, as fast as
+ * they go, in the batches run() had: bars are drawn after each, root
+ * motion coalesced live is coalesced again. The client windows are
+ * recreated from their CreateNotify and destroyed or unmapped along with
+ * the trace, live events are discarded. Property contents and pointer
+ * drags are not part of a trace, clients therefore keep the properties of
+ * a fresh window; bindings that act outside of dwm are not run, see
+ * external(). */
+void
+replay(const char *path)
+{
+	XEvent ev, next, live;
+	XSetWindowAttributes wa;
+	Monitor *m;
+	Client *c;
+	Window w, gone;
+	IpcBuf b = {0};
+	struct timespec t0, t1;
+	unsigned long req;
+	char magic[8], *name;
+	uint32_t hdr[2];
+	int flags, nextflags, more, nclients = 0;
+
+	if (!(tracein = fopen(path, "r")))
+		die("dwm: cannot open trace '%s':", path);
+	if (fread(magic, sizeof magic, 1, tracein) != 1 || memcmp(magic, "dwmtrace", sizeof magic)
+	|| fread(hdr, sizeof hdr, 1, tracein) != 1 || hdr[0] != 3 || hdr[1] != sizeof(XEvent))
+		die("dwm: '%s' is not a trace of this build", path);
+	XSync(dpy, False);
+	req = NextRequest(dpy);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t0);
+	more = traceread(&next, &nextflags);
+	while (running && more) {
+		ev = next;
+		flags = nextflags;
+		more = traceread(&next, &nextflags);
+		if (ev.type == 0) {
+			if (ev.xany.serial == TRACEATOM) {
+				name = (char *)&ev + sizeof(XAnyEvent);
+				name[sizeof(XEvent) - sizeof(XAnyEvent) - 1] = '\0';
+				tracebind(&traceatoms, ev.xany.window, XInternAtom(dpy, name, False));
+			} else if (ev.xany.serial == (unsigned long)-1)
+				tracebind(&tracewins, ev.xany.window, root);
+			else
+				for (m = mons; m; m = m->next)
+					if (m->num == (int)ev.xany.serial)
+						tracebind(&tracewins, ev.xany.window, m->barwin);
+			continue;
+		}
+		/* bars of dwm are known by their record of type 0 already */
+		if (ev.type == CreateNotify && tracemap(&tracewins, ev.xcreatewindow.parent) == root
+		&& !tracemap(&tracewins, ev.xcreatewindow.window)) {
+			wa.override_redirect = ev.xcreatewindow.override_redirect;
+			w = XCreateWindow(dpy, root, ev.xcreatewindow.x, ev.xcreatewindow.y,
+				MAX(ev.xcreatewindow.width, 1), MAX(ev.xcreatewindow.height, 1),
+				ev.xcreatewindow.border_width, CopyFromParent, InputOutput,
+				CopyFromParent, CWOverrideRedirect, &wa);
+			tracebind(&tracewins, ev.xcreatewindow.window, w);
+		}
+		if (flags & TRACEBATCH) {
+			drawdirtybars();
+			ipc_flush(ipc);
+		}
+		/* the motion motionnotify() took in along with this one */
+		for (; more && nextflags & TRACEMERGED; more = traceread(&next, &nextflags)) {
+			ev = next;
+			motionevents++;
+			motioncoalesced++;
+		}
+		gone = ev.type == DestroyNotify ? ev.xdestroywindow.window : None;
+		tracexlate(&ev);
+		/* what the client did to its window */
+		if (ev.type == UnmapNotify && !ev.xany.send_event && ev.xunmap.window)
+			XUnmapWindow(dpy, ev.xunmap.window);
+		while (XPending(dpy))
+			XNextEvent(dpy, &live);
+		xevents++;
+		dispatch(&ev);
+		if (gone && ev.xdestroywindow.window) {
+			XDestroyWindow(dpy, ev.xdestroywindow.window);
+			/* the copy of the event for the parent then finds nothing */
+			tracebind(&tracewins, gone, None);
+		}
+	}
+	drawdirtybars();
+	XSync(dpy, False);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			nclients++;
+	fprintf(stderr, "dwm: replayed %lu events in %.3f s cpu, %lu requests, %d clients\n",
+		xevents, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+		NextRequest(dpy) - req, nclients);
+	/* the counters get_stats had for the recording, to compare */
+	ipcstats(&b);
+	fprintf(stderr, "dwm: stats %.*s\n", (int)b.len, b.data);
+	ipc_buf_free(&b);
+}
+
+/* Follows a change of the screen size or monitor layout. */
+void
+rescreen(int dirty)
+{
+	Monitor *m;
+	Client *c;
+
+	/* TODO: updategeom handling sucks, needs to be simplified */
+	if (updategeom() || dirty) {
+		updatebars();
+		for (m = mons; m; m = m->next) {
+			for (c = m->clients; c; c = c->next)
+				if (c->isfullscreen)
+					resizeclient(c, m->mx, m->my, m->mw, m->mh);
+			XMoveResizeWindow(dpy, m->barwin, m->wx + sp, m->by + vp, m->ww -  2 * sp, bh);
+		}
+		focus(NULL);
+		arrange(NULL);
+	}
+}
+
 void
 resize(Client *c, int x, int y, int w, int h, int interact)
 {
@@ -1327,26 +2823,19 @@ resize(Client *c, int x, int y, int w, int h, int interact)
 void
 resizeclient(Client *c, int x, int y, int w, int h)
 {
-	XWindowChanges wc;
-
-	c->oldx = c->x; c->x = wc.x = x;
-	c->oldy = c->y; c->y = wc.y = y;
-	c->oldw = c->w; c->w = wc.width = w;
-	c->oldh = c->h; c->h = wc.height = h;
-	wc.border_width = c->bw;
-	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
-	configure(c);
+	c->mon->last.valid = 0; /* moved outside a layout */
+	placeclient(c, x, y, w, h);
 	XSync(dpy, False);
 }
 
 void
 resizemouse(const Arg *arg)
 {
-	int ocx, ocy, nw, nh;
+	int nx, ny, ocx, ocy, nw, nh;
 	Client *c;
 	Monitor *m;
 	XEvent ev;
-	Time lasttime = 0;
+	Drag d;
 
 	if (!(c = selmon->sel))
 		return;
@@ -1359,33 +2848,26 @@ resizemouse(const Arg *arg)
 		None, cursor[CurResize]->cursor, CurrentTime) != GrabSuccess)
 		return;
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
-	do {
-		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
-		switch(ev.type) {
-		case ConfigureRequest:
-		case Expose:
-		case MapRequest:
-			handler[ev.type](&ev);
-			break;
-		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nw = MAX(ev.xmotion.x - ocx - 2 * c->bw + 1, 1);
-			nh = MAX(ev.xmotion.y - ocy - 2 * c->bw + 1, 1);
-			if (c->mon->wx + nw >= selmon->wx && c->mon->wx + nw <= selmon->wx + selmon->ww
-			&& c->mon->wy + nh >= selmon->wy && c->mon->wy + nh <= selmon->wy + selmon->wh)
-			{
-				if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
-				&& (abs(nw - c->w) > snap || abs(nh - c->h) > snap))
-					togglefloating(NULL);
-			}
-			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
-				resize(c, c->x, c->y, nw, nh, 1);
-			break;
+	dragstart(&d, c, 1);
+	while (dragnext(&d)) {
+		nw = MAX(d.x - ocx - 2 * c->bw + 1, 1);
+		nh = MAX(d.y - ocy - 2 * c->bw + 1, 1);
+		if (c->mon->wx + nw >= selmon->wx && c->mon->wx + nw <= selmon->wx + selmon->ww
+		&& c->mon->wy + nh >= selmon->wy && c->mon->wy + nh <= selmon->wy + selmon->wh)
+		{
+			if (!c->isfloating && selmon->lt[selmon->sellt]->arrange
+			&& (abs(nw - c->w) > snap || abs(nh - c->h) > snap))
+				togglefloating(NULL);
+		}
+		nx = c->x;
+		ny = c->y;
+		if ((!selmon->lt[selmon->sellt]->arrange || c->isfloating)
+		&& applysizehints(c, &nx, &ny, &nw, &nh, 1)) {
+			dragsync(&d, c);
+			dragplace(c, nx, ny, nw, nh);
 		}
-	} while (ev.type != ButtonRelease);
+	}
+	dragend(&d);
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
 	XUngrabPointer(dpy, CurrentTime);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
@@ -1399,37 +2881,175 @@ resizemouse(const Arg *arg)
 void
 restack(Monitor *m)
 {
-	Client *c;
 	XEvent ev;
-	XWindowChanges wc;
 
-	drawbar(m);
+	/* the status alone does not change with the clients */
+	dirtybar(m, BarTags|BarLayout|BarTitle);
 	if (!m->sel)
 		return;
-	if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
+	if (m->sel->isfloating || !m->lt[m->sellt]->arrange) {
 		XRaiseWindow(dpy, m->sel->win);
-	if (m->lt[m->sellt]->arrange) {
-		wc.stack_mode = Below;
-		wc.sibling = m->barwin;
-		for (c = m->stack; c; c = c->snext)
-			if (!c->isfloating && ISVISIBLE(c)) {
-				XConfigureWindow(dpy, c->win, CWSibling|CWStackMode, &wc);
-				wc.sibling = c->win;
-			}
+		stackplace(m->sel->win, None);
+		winmoved = 1;
 	}
+	if (m->lt[m->sellt]->arrange)
+		winmoved |= restacktiled(m);
+	else
+		m->nstacked = 0; /* the raise may have reordered tiled windows */
+	updateclientstacking();
+	if (!winmoved)
+		return;
+	/* discard the crossing events caused by rearranging */
+	winmoved = 0;
 	XSync(dpy, False);
 	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
 }
 
+/* Stacks the visible tiled clients of m in focus order below the bar.
+ * Relative to the order last sent, the windows on a longest run that is
+ * still in order stay put; only the others are moved below their new
+ * upper neighbour. Each client remembers its place in the order sent, so
+ * this takes O(n log n). Returns whether anything was sent. */
+int
+restacktiled(Monitor *m)
+{
+	int *pos, *tail, *prev, *keep;
+	int i, lo, hi, mid, k, n, sent = 0;
+	Client *c;
+	XWindowChanges wc;
+
+	updatetiled(m);
+	if ((n = m->ntiled) > restacksize) {
+		restacksize = n;
+		free(restackwin);
+		free(restackpos);
+		restackwin = ecalloc(restacksize, sizeof(Window));
+		restackpos = ecalloc(4 * restacksize, sizeof(int));
+	}
+	pos = restackpos;
+	tail = pos + restacksize;
+	prev = tail + restacksize;
+	keep = prev + restacksize;
+	for (n = 0, c = m->stack; c; c = c->snext)
+		if (!c->isfloating && ISVISIBLE(c)) {
+			pos[n] = m->nstacked && c->stackgen == m->stackgen ? c->stackpos : -1;
+			restackwin[n++] = c->win;
+		}
+	if (n == m->nstacked && !memcmp(restackwin, m->stacked, n * sizeof(Window)))
+		return 0;
+
+	/* a window that left the order but is still shown, i.e. turned
+	 * floating, must not remain between tiled ones: restack them all */
+	for (i = 0; i < m->nvisible; i++) {
+		c = m->visible[i];
+		if (c->isfloating && m->nstacked && c->stackgen == m->stackgen) {
+			for (k = 0; k < n; k++)
+				pos[k] = -1;
+			break;
+		}
+	}
+
+	/* longest increasing run of old positions by patience sorting: tail[k]
+	 * ends the best run of length k + 1 found so far */
+	for (k = i = 0; i < n; i++) {
+		keep[i] = 0;
+		if (pos[i] < 0)
+			continue;
+		for (lo = 0, hi = k; lo < hi; ) {
+			mid = (lo + hi) / 2;
+			if (pos[tail[mid]] < pos[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		prev[i] = lo ? tail[lo - 1] : -1;
+		tail[lo] = i;
+		if (lo == k)
+			k++;
+	}
+	for (i = k ? tail[k - 1] : -1; i >= 0; i = prev[i])
+		keep[i] = 1;
+
+	wc.stack_mode = Below;
+	for (i = 0; i < n; i++)
+		if (!keep[i]) {
+			wc.sibling = i ? restackwin[i - 1] : m->barwin;
+			XConfigureWindow(dpy, restackwin[i], CWSibling|CWStackMode, &wc);
+			stackplace(restackwin[i], wc.sibling);
+			sent = 1;
+		}
+
+	if (n > m->stackedsize) {
+		m->stackedsize = n;
+		free(m->stacked);
+		m->stacked = ecalloc(n, sizeof(Window));
+	}
+	memcpy(m->stacked, restackwin, n * sizeof(Window));
+	m->nstacked = n;
+	m->stackgen = ++stackgen;
+	for (n = 0, c = m->stack; c; c = c->snext)
+		if (!c->isfloating && ISVISIBLE(c)) {
+			c->stackpos = n++;
+			c->stackgen = stackgen;
+		}
+	return sent;
+}
+
+unsigned long
+rulehash(const char *s)
+{
+	unsigned long h = 2166136261UL;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619UL;
+	return h;
+}
+
+/* Matches s against a rule pattern: NULL matches anything, a pattern with
+ * glob characters goes to fnmatch(3), any other has to be equal. */
+int
+rulematch(const char *pattern, const char *s)
+{
+	if (!pattern)
+		return 1;
+	if (strpbrk(pattern, "*?[\\"))
+		return !fnmatch(pattern, s, 0);
+	return !strcmp(pattern, s);
+}
+
 void
 run(void)
 {
 	XEvent ev;
+	int first;
 	/* main event loop */
 	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
-			handler[ev.type](&ev); /* call handler */
+	while (running) {
+		for (first = 1; running && XPending(dpy); first = 0) {
+			XNextEvent(dpy, &ev);
+			xevents++;
+			if (traceout)
+				tracewrite(&ev, first ? TRACEBATCH : 0);
+			dispatch(&ev);
+		}
+		/* bars marked by the handlers are drawn once per batch, which
+		 * may queue further events, and subscribers get the batch's
+		 * events in one write */
+		drawdirtybars();
+		ipc_flush(ipc);
+		/* XPending() has flushed the output buffer, sleep until the
+		 * X connection or an ipc client has something for us */
+		if (running && !XPending(dpy)) {
+			xidles++;
+			if (traceout)
+				fflush(traceout);
+			ipc_poll(ipc, ConnectionNumber(dpy), -1);
+		}
+#ifdef EVSTATS
+		if (evdumpreq)
+			evdump();
+#endif /* EVSTATS */
+	}
 }
 
 void
@@ -1509,32 +3129,242 @@ runautostart(void)
 	free(path);
 }
 
+#ifdef XCB
+enum { PropName, PropWMName, PropTrans, PropState, PropType,
+       PropNormalHints, PropHints, PropClass, PropLast }; /* scan() property requests */
+
+static xcb_get_property_cookie_t
+xcbgetprop(xcb_connection_t *xc, Window w, Atom prop, Atom type, uint32_t len)
+{
+	return xcb_get_property(xc, 0, w, prop, type, 0, len);
+}
+
+/* Returns the value of a property reply with the given format and at least
+ * min items, or NULL. */
+static void *
+xcbpropval(xcb_get_property_reply_t *r, int format, int min, int *n)
+{
+	if (!r || r->format != format
+	|| (*n = xcb_get_property_value_length(r) / (format / 8)) < min)
+		return NULL;
+	return xcb_get_property_value(r);
+}
+
+/* mirrors gettitle() on prefetched replies, WM_NAME in compound text takes
+ * the synchronous path */
+static unsigned int
+xcbtitle(xcb_get_property_reply_t **r, Window w, char *name)
+{
+	unsigned char *v;
+	unsigned int len = 0;
+	int n;
+
+	if ((v = xcbpropval(r[PropName], 8, 1, &n)) && r[PropName]->type == utf8string)
+		len = titlecpy(name, v, n, 0);
+	if (!len && (v = xcbpropval(r[PropWMName], 8, 1, &n))) {
+		if (r[PropWMName]->type != XA_STRING && r[PropWMName]->type != utf8string)
+			return gettitle(w, name);
+		len = titlecpy(name, v, n, r[PropWMName]->type == XA_STRING);
+	}
+	if (!len) /* hack to mark broken clients */
+		len = titlecpy(name, (unsigned char *)broken, sizeof broken - 1, 0);
+	return len;
+}
+
+static void
+xcbprops(xcb_get_property_reply_t **r, Window w, Props *p)
+{
+	uint32_t *v;
+	char *c;
+	unsigned long len;
+	int n;
+
+	p->namelen = xcbtitle(r, w, p->name);
+	/* WM_CLASS holds the instance and the class, each ended by a NUL */
+	p->instance[0] = p->class[0] = '\0';
+	if ((c = xcbpropval(r[PropClass], 8, 1, &n)) && (len = classcpy(p->instance, c, n)) < (unsigned long)n)
+		classcpy(p->class, c + len + 1, n - len - 1);
+	p->trans = (v = xcbpropval(r[PropTrans], 32, 1, &n)) ? v[0] : None;
+	p->state = (v = xcbpropval(r[PropState], 32, 1, &n)) ? v[0] : None;
+	p->wtype = (v = xcbpropval(r[PropType], 32, 1, &n)) ? v[0] : None;
+	/* see XGetWMNormalHints(3) and XGetWMHints(3) for the wire layout */
+	p->size.flags = 0;
+	if ((v = xcbpropval(r[PropNormalHints], 32, 15, &n))) {
+		p->size.flags = v[0] & (USPosition|USSize|PAllHints
+			| (n >= 18 ? PBaseSize|PWinGravity : 0));
+		p->size.x = (int32_t)v[1];
+		p->size.y = (int32_t)v[2];
+		p->size.width = (int32_t)v[3];
+		p->size.height = (int32_t)v[4];
+		p->size.min_width = (int32_t)v[5];
+		p->size.min_height = (int32_t)v[6];
+		p->size.max_width = (int32_t)v[7];
+		p->size.max_height = (int32_t)v[8];
+		p->size.width_inc = (int32_t)v[9];
+		p->size.height_inc = (int32_t)v[10];
+		p->size.min_aspect.x = (int32_t)v[11];
+		p->size.min_aspect.y = (int32_t)v[12];
+		p->size.max_aspect.x = (int32_t)v[13];
+		p->size.max_aspect.y = (int32_t)v[14];
+		if (n >= 18) {
+			p->size.base_width = (int32_t)v[15];
+			p->size.base_height = (int32_t)v[16];
+			p->size.win_gravity = (int32_t)v[17];
+		}
+	}
+	p->wmh.flags = 0;
+	if ((v = xcbpropval(r[PropHints], 32, 8, &n))) {
+		p->wmh.flags = v[0] & ~(n < 9 ? WindowGroupHint : 0);
+		p->wmh.input = v[1];
+		p->wmh.initial_state = v[2];
+		p->wmh.icon_pixmap = v[3];
+		p->wmh.icon_window = v[4];
+		p->wmh.icon_x = (int32_t)v[5];
+		p->wmh.icon_y = (int32_t)v[6];
+		p->wmh.icon_mask = v[7];
+		p->wmh.window_group = n >= 9 ? v[8] : None;
+	}
+}
+
+/* Adopts the existing windows in three round trips instead of several per
+ * window: the tree, then the attributes of all children and then the
+ * properties of the windows to be managed, each stage with all requests in
+ * flight before the first reply is read. */
+void
+scan(void)
+{
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+	xcb_query_tree_reply_t *tree;
+	xcb_get_window_attributes_cookie_t *attrck;
+	xcb_get_geometry_cookie_t *geomck;
+	xcb_get_property_cookie_t *propck, *ck;
+	xcb_get_window_attributes_reply_t *attr;
+	xcb_get_geometry_reply_t *geom;
+	xcb_get_property_reply_t *r[PropLast];
+	unsigned int i, j, n, num, pass;
+	uint32_t *v;
+	Window *wins;
+	XWindowAttributes *wa;
+	Props *props;
+	int *trans, di;
+
+	XFlush(dpy);
+	if (!(tree = xcb_query_tree_reply(xc, xcb_query_tree(xc, root), NULL)))
+		return;
+	num = xcb_query_tree_children_length(tree);
+	attrck = ecalloc(num, sizeof(xcb_get_window_attributes_cookie_t));
+	geomck = ecalloc(num, sizeof(xcb_get_geometry_cookie_t));
+	propck = ecalloc(num * PropLast, sizeof(xcb_get_property_cookie_t));
+	wins = ecalloc(num, sizeof(Window));
+	for (i = 0; i < num; i++) {
+		wins[i] = xcb_query_tree_children(tree)[i];
+		attrck[i] = xcb_get_window_attributes(xc, wins[i]);
+		geomck[i] = xcb_get_geometry(xc, wins[i]);
+		ck = &propck[i * PropLast];
+		ck[PropTrans] = xcbgetprop(xc, wins[i], XA_WM_TRANSIENT_FOR, XA_WINDOW, 1);
+		ck[PropState] = xcbgetprop(xc, wins[i], wmatom[WMState], wmatom[WMState], 2);
+	}
+	free(tree);
+
+	wa = ecalloc(num, sizeof(XWindowAttributes));
+	trans = ecalloc(num, sizeof(int));
+	for (i = n = 0; i < num; i++) {
+		ck = &propck[i * PropLast];
+		attr = xcb_get_window_attributes_reply(xc, attrck[i], NULL);
+		geom = xcb_get_geometry_reply(xc, geomck[i], NULL);
+		r[PropTrans] = xcb_get_property_reply(xc, ck[PropTrans], NULL);
+		r[PropState] = xcb_get_property_reply(xc, ck[PropState], NULL);
+		v = xcbpropval(r[PropState], 32, 1, &di);
+		if (attr && geom && !attr->override_redirect
+		&& (attr->map_state == XCB_MAP_STATE_VIEWABLE || (v && v[0] == IconicState))) {
+			wins[n] = wins[i];
+			wa[n].x = geom->x;
+			wa[n].y = geom->y;
+			wa[n].width = geom->width;
+			wa[n].height = geom->height;
+			wa[n].border_width = geom->border_width;
+			wa[n].map_state = attr->map_state;
+			trans[n++] = xcbpropval(r[PropTrans], 32, 1, &di) != NULL;
+		}
+		free(attr);
+		free(geom);
+		free(r[PropTrans]);
+		free(r[PropState]);
+	}
+
+	for (i = 0; i < n; i++) {
+		ck = &propck[i * PropLast];
+		ck[PropName] = xcbgetprop(xc, wins[i], netatom[NetWMName], utf8string, TITLEMAX / 4);
+		ck[PropWMName] = xcbgetprop(xc, wins[i], XA_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, TITLEMAX / 4);
+		ck[PropTrans] = xcbgetprop(xc, wins[i], XA_WM_TRANSIENT_FOR, XA_WINDOW, 1);
+		ck[PropState] = xcbgetprop(xc, wins[i], netatom[NetWMState], XA_ATOM, 1);
+		ck[PropType] = xcbgetprop(xc, wins[i], netatom[NetWMWindowType], XA_ATOM, 1);
+		ck[PropNormalHints] = xcbgetprop(xc, wins[i], XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 18);
+		ck[PropHints] = xcbgetprop(xc, wins[i], XA_WM_HINTS, XA_WM_HINTS, 9);
+		ck[PropClass] = xcbgetprop(xc, wins[i], XA_WM_CLASS, XA_STRING, 2 * CLASSMAX / 4);
+	}
+	props = ecalloc(MAX(n, 1), sizeof(Props));
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < PropLast; j++)
+			r[j] = xcb_get_property_reply(xc, propck[i * PropLast + j], NULL);
+		xcbprops(r, wins[i], &props[i]);
+		for (j = 0; j < PropLast; j++)
+			free(r[j]);
+	}
+
+	scanning = 1;
+	for (pass = 0; pass < 2; pass++) /* transients after their parents */
+		for (i = 0; i < n; i++)
+			if (trans[i] == pass && !wintoclient(wins[i]))
+				manage(wins[i], &wa[i], &props[i]);
+	scanning = 0;
+	arrange(NULL);
+	focus(NULL);
+	free(props);
+	free(trans);
+	free(wa);
+	free(wins);
+	free(propck);
+	free(geomck);
+	free(attrck);
+}
+#else
 void
 scan(void)
 {
 	unsigned int i, num;
 	Window d1, d2, *wins = NULL;
 	XWindowAttributes wa;
+	Props p;
 
 	if (XQueryTree(dpy, root, &d1, &d2, &wins, &num)) {
+		scanning = 1;
 		for (i = 0; i < num; i++) {
 			if (!XGetWindowAttributes(dpy, wins[i], &wa)
 			|| wa.override_redirect || XGetTransientForHint(dpy, wins[i], &d1))
 				continue;
-			if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)
-				manage(wins[i], &wa);
+			if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState) {
+				getprops(wins[i], &p);
+				manage(wins[i], &wa, &p);
+			}
 		}
 		for (i = 0; i < num; i++) { /* now the transients */
 			if (!XGetWindowAttributes(dpy, wins[i], &wa))
 				continue;
 			if (XGetTransientForHint(dpy, wins[i], &d1)
-			&& (wa.map_state == IsViewable || getstate(wins[i]) == IconicState))
-				manage(wins[i], &wa);
+			&& (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)) {
+				getprops(wins[i], &p);
+				manage(wins[i], &wa, &p);
+			}
 		}
+		scanning = 0;
+		arrange(NULL);
+		focus(NULL);
 		if (wins)
 			XFree(wins);
 	}
 }
+#endif /* XCB */
 
 void
 sendmon(Client *c, Monitor *m)
@@ -1542,12 +3372,15 @@ sendmon(Client *c, Monitor *m)
 	if (c->mon == m)
 		return;
 	unfocus(c, 1);
+	unstack(c->mon, c->win);
+	tagcount(c, -1);
 	detach(c);
 	detachstack(c);
 	c->mon = m;
 	c->tags = m->tagset[m->seltags]; /* assign tags of target monitor */
 	attach(c);
 	attachstack(c);
+	tagcount(c, 1);
 	focus(NULL);
 	arrange(NULL);
 }
@@ -1609,13 +3442,18 @@ setfullscreen(Client *c, int fullscreen)
 		c->oldbw = c->bw;
 		c->bw = 0;
 		c->isfloating = 1;
+		c->mon->tiledstale = 1;
 		resizeclient(c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh);
 		XRaiseWindow(dpy, c->win);
+		stackplace(c->win, None);
+		updateclientstacking();
+		c->mon->nstacked = 0; /* raised out of the stacked order */
 	} else if (!fullscreen && c->isfullscreen){
 		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
 			PropModeReplace, (unsigned char*)0, 0);
 		c->isfullscreen = 0;
 		c->isfloating = c->oldstate;
+		c->mon->tiledstale = 1;
 		c->bw = c->oldbw;
 		c->x = c->oldx;
 		c->y = c->oldy;
@@ -1667,6 +3505,7 @@ setlayout(const Arg *arg)
 		arrange(selmon);
 	else
 		drawbar(selmon);
+	ipcevent(IpcEvLayout, selmon, NULL, NULL);
 }
 
 /* arg > 1.0 will set mfact absolutely */
@@ -1684,45 +3523,146 @@ setmfact(const Arg *arg)
 	arrange(selmon);
 }
 
+/* arg->i 1 draws the bars client-side in shared memory, if the server
+ * allows it, 0 with core requests */
+void
+setshmbar(const Arg *arg)
+{
+	Monitor *m;
+
+	if (arg->i)
+		drw_shm_enable(drw);
+	else
+		drw->shm = 0;
+	for (m = mons; m; m = m->next) {
+		drw_surf_free(drw, m->barbuf);
+		m->barbuf = NULL;
+	}
+	updatebars();
+	for (m = mons; m; m = m->next)
+		dirtybar(m, BarAll);
+}
+
+void
+setsizehints(Client *c, XSizeHints *size)
+{
+	Hints *h = &c->hints;
+
+	c->mon->last.valid = 0;
+	if (size->flags & PBaseSize) {
+		h->basew = size->base_width;
+		h->baseh = size->base_height;
+	} else if (size->flags & PMinSize) {
+		h->basew = size->min_width;
+		h->baseh = size->min_height;
+	} else
+		h->basew = h->baseh = 0;
+	if (size->flags & PResizeInc) {
+		h->incw = size->width_inc;
+		h->inch = size->height_inc;
+	} else
+		h->incw = h->inch = 0;
+	if (size->flags & PMaxSize) {
+		h->maxw = size->max_width;
+		h->maxh = size->max_height;
+	} else
+		h->maxw = h->maxh = 0;
+	if (size->flags & PMinSize) {
+		h->minw = size->min_width;
+		h->minh = size->min_height;
+	} else if (size->flags & PBaseSize) {
+		h->minw = size->base_width;
+		h->minh = size->base_height;
+	} else
+		h->minw = h->minh = 0;
+	if (size->flags & PAspect) {
+		h->mina = (float)size->min_aspect.y / size->min_aspect.x;
+		h->maxa = (float)size->max_aspect.x / size->max_aspect.y;
+	} else
+		h->maxa = h->mina = 0.0;
+	c->isfixed = (h->maxw && h->maxh && h->maxw == h->minw && h->maxh == h->minh);
+}
+
+/* Stores a title in the client's buffer, growing it as needed. Unchanged
+ * titles are told apart by length and hash first and return 0. */
+int
+settitle(Client *c, const char *name, unsigned int len)
+{
+	unsigned long h = 2166136261UL;
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)name[i]) * 16777619UL;
+	if (c->name && len == c->namelen && h == c->namehash
+	&& !memcmp(c->name, name, len))
+		return 0;
+	if (len >= c->namesize) {
+		c->namesize = (len + 32) & ~31U;
+		if (!(c->name = realloc(c->name, c->namesize)))
+			die("realloc:");
+	}
+	memcpy(c->name, name, len);
+	c->name[len] = '\0';
+	c->namelen = len;
+	c->namehash = h;
+	return 1;
+}
+
 void
 setup(void)
 {
 	int i;
 	XSetWindowAttributes wa;
-	Atom utf8string;
 
 	/* clean up any zombies immediately */
 	sigchld(0);
+#ifdef EVSTATS
+	if (signal(SIGUSR2, sigusr2) == SIG_ERR)
+		die("can't install SIGUSR2 handler:");
+#endif /* EVSTATS */
 
 	/* init screen */
 	screen = DefaultScreen(dpy);
 	sw = DisplayWidth(dpy, screen);
 	sh = DisplayHeight(dpy, screen);
 	root = RootWindow(dpy, screen);
-	drw = drw_create(dpy, screen, root, sw, sh);
+	drw = drw_create(dpy, screen, root, 0, 0); /* bars bring their own buffers */
+	if (shmbar)
+		drw_shm_enable(drw);
 	if (!drw_fontset_create(drw, fonts, LENGTH(fonts)))
 		die("no fonts could be loaded.");
 	lrpad = drw->fonts->h + horizpadbar;
 	bh = drw->fonts->h + vertpadbar;
 	sp = sidepad;
 	vp = (topbar == 1) ? vertpad : - vertpad;
+#ifdef XRANDR
+	{
+		int major, minor;
+
+		if (XRRQueryExtension(dpy, &randrevbase, &i) && XRRQueryVersion(dpy, &major, &minor)
+		&& (major > 1 || (major == 1 && minor >= 5)))
+			XRRSelectInput(dpy, root, RRScreenChangeNotifyMask
+				|RRCrtcChangeNotifyMask|RROutputChangeNotifyMask);
+		else
+			randrevbase = -1;
+	}
+#endif /* XRANDR */
 	updategeom();
 
 	/* init atoms */
-	utf8string = XInternAtom(dpy, "UTF8_STRING", False);
-	wmatom[WMProtocols] = XInternAtom(dpy, "WM_PROTOCOLS", False);
-	wmatom[WMDelete] = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
-	wmatom[WMState] = XInternAtom(dpy, "WM_STATE", False);
-	wmatom[WMTakeFocus] = XInternAtom(dpy, "WM_TAKE_FOCUS", False);
-	netatom[NetActiveWindow] = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
-	netatom[NetSupported] = XInternAtom(dpy, "_NET_SUPPORTED", False);
-	netatom[NetWMName] = XInternAtom(dpy, "_NET_WM_NAME", False);
-	netatom[NetWMState] = XInternAtom(dpy, "_NET_WM_STATE", False);
-	netatom[NetWMCheck] = XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False);
-	netatom[NetWMFullscreen] = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
-	netatom[NetWMWindowType] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
-	netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
-	netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	for (i = 0; i < WMLast; i++)
+		atomreg(&wmatom[i], wmatomnames[i]);
+	for (i = 0; i < NetLast; i++)
+		atomreg(&netatom[i], netatomnames[i]);
+	atomreg(&utf8string, "UTF8_STRING");
+#ifdef XSYNC
+	atomreg(&syncatom[0], "_NET_WM_SYNC_REQUEST");
+	atomreg(&syncatom[1], "_NET_WM_SYNC_REQUEST_COUNTER");
+	if (!XSyncQueryExtension(dpy, &syncevbase, &i) || !XSyncInitialize(dpy, &i, &i))
+		syncevbase = -1;
+#endif /* XSYNC */
+	compilerules(rules, LENGTH(rules));
+	atomsintern();
 	/* init cursors */
 	cursor[CurNormal] = drw_cur_create(drw, XC_left_ptr);
 	cursor[CurResize] = drw_cur_create(drw, XC_sizing);
@@ -1745,16 +3685,23 @@ setup(void)
 	/* EWMH support per view */
 	XChangeProperty(dpy, root, netatom[NetSupported], XA_ATOM, 32,
 		PropModeReplace, (unsigned char *) netatom, NetLast);
+#ifdef XSYNC
+	if (syncevbase >= 0)
+		XChangeProperty(dpy, root, netatom[NetSupported], XA_ATOM, 32,
+			PropModeAppend, (unsigned char *) syncatom, 1);
+#endif /* XSYNC */
 	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	XDeleteProperty(dpy, root, netatom[NetClientListStacking]);
 	/* select events */
 	wa.cursor = cursor[CurNormal]->cursor;
-	wa.event_mask = SubstructureRedirectMask|SubstructureNotifyMask
-		|ButtonPressMask|PointerMotionMask|EnterWindowMask
-		|LeaveWindowMask|StructureNotifyMask|PropertyChangeMask;
+	wa.event_mask = ROOTMASK;
 	XChangeWindowAttributes(dpy, root, CWEventMask|CWCursor, &wa);
 	XSelectInput(dpy, root, wa.event_mask);
+	updatenumlockmask();
 	grabkeys();
 	focus(NULL);
+	/* init ipc socket */
+	ipc = ipc_create(ipcpath(), ipcmessage);
 }
 
 
@@ -1763,7 +3710,11 @@ seturgent(Client *c, int urg)
 {
 	XWMHints *wmh;
 
-	c->isurgent = urg;
+	if (c->isurgent != urg) {
+		tagcount(c, -1);
+		c->isurgent = urg;
+		tagcount(c, 1);
+	}
 	if (!(wmh = XGetWMHints(dpy, c->win)))
 		return;
 	wmh->flags = urg ? (wmh->flags | XUrgencyHint) : (wmh->flags & ~XUrgencyHint);
@@ -1771,22 +3722,89 @@ seturgent(Client *c, int urg)
 	XFree(wmh);
 }
 
+void
+setwindowtype(Client *c, Atom state, Atom wtype)
+{
+	if (state == netatom[NetWMFullscreen])
+		setfullscreen(c, 1);
+	if (wtype == netatom[NetWMWindowTypeDialog]) {
+		c->isfloating = 1;
+		c->mon->tiledstale = 1;
+	}
+}
+
+void
+setwmhints(Client *c, XWMHints *wmh)
+{
+	if (c == selmon->sel && wmh->flags & XUrgencyHint) {
+		wmh->flags &= ~XUrgencyHint;
+		XSetWMHints(dpy, c->win, wmh);
+	} else if (!c->isurgent != !(wmh->flags & XUrgencyHint)) {
+		tagcount(c, -1);
+		c->isurgent = !c->isurgent;
+		tagcount(c, 1);
+	}
+	if (wmh->flags & InputHint)
+		c->neverfocus = !wmh->input;
+	else
+		c->neverfocus = 0;
+}
+
+/* Shows the visible clients of the stack starting at c top down, then
+ * hides the others bottom up, as one batch of requests. */
 void
 showhide(Client *c)
 {
+	int x, y, w, h, grabbed = 0;
+	Client *last = NULL;
+
 	if (!c)
 		return;
-	if (ISVISIBLE(c)) {
-		/* show clients top down */
+	winmoved = 1;
+	for (; c; last = c, c = c->snext) {
+		if (!ISVISIBLE(c))
+			continue;
 		XMoveWindow(dpy, c->win, c->x, c->y);
-		if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) && !c->isfullscreen)
-			resize(c, c->x, c->y, c->w, c->h, 0);
-		showhide(c->snext);
-	} else {
-		/* hide clients bottom up */
-		showhide(c->snext);
-		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+		if (c->hidden) {
+			XMapWindow(dpy, c->win);
+			setclientstate(c, NormalState);
+			c->hidden = 0;
+		}
+		if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) && !c->isfullscreen) {
+			x = c->x;
+			y = c->y;
+			w = c->w;
+			h = c->h;
+			if (applysizehints(c, &x, &y, &w, &h, 0))
+				placeclient(c, x, y, w, h);
+		}
+	}
+	for (c = last; c; c = c->sprev) {
+		if (ISVISIBLE(c))
+			continue;
+		if (!unmaphidden) {
+			XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+			continue;
+		}
+		if (c->hidden)
+			continue;
+		/* keep our own unmaps from looking like the client withdrawing */
+		if (!grabbed) {
+			XGrabServer(dpy);
+			XSelectInput(dpy, root, ROOTMASK & ~SubstructureNotifyMask);
+			grabbed = 1;
+		}
+		XSelectInput(dpy, c->win, CLIENTMASK & ~StructureNotifyMask);
+		XUnmapWindow(dpy, c->win);
+		XSelectInput(dpy, c->win, CLIENTMASK);
+		setclientstate(c, IconicState);
+		c->hidden = 1;
+	}
+	if (grabbed) {
+		XSelectInput(dpy, root, ROOTMASK);
+		XUngrabServer(dpy);
 	}
+	XSync(dpy, False);
 }
 
 void
@@ -1797,6 +3815,14 @@ sigchld(int unused)
 	while (0 < waitpid(-1, NULL, WNOHANG));
 }
 
+#ifdef EVSTATS
+void
+sigusr2(int unused)
+{
+	evdumpreq = 1; /* run() dumps once poll() returns */
+}
+#endif /* EVSTATS */
+
 void
 spawn(const Arg *arg)
 {
@@ -1813,16 +3839,72 @@ spawn(const Arg *arg)
 	}
 }
 
+/* Mirrors a stacking request for w in stacklist: w goes right below
+ * sibling or, without one, on top. */
+void
+stackplace(Window w, Window sibling)
+{
+	unsigned int i;
+
+	stackremove(w);
+	if (nstacklist == stacklistsize) {
+		stacklistsize = MAX(2 * stacklistsize, 32);
+		if (!(stacklist = realloc(stacklist, stacklistsize * sizeof(Window)))
+		|| !(stacksent = realloc(stacksent, stacklistsize * sizeof(Window))))
+			die("realloc:");
+	}
+	i = nstacklist;
+	if (sibling)
+		for (i = 0; i < nstacklist && stacklist[i] != sibling; i++);
+	memmove(&stacklist[i + 1], &stacklist[i], (nstacklist - i) * sizeof(Window));
+	stacklist[i] = w;
+	nstacklist++;
+}
+
+void
+stackremove(Window w)
+{
+	unsigned int i;
+
+	for (i = 0; i < nstacklist && stacklist[i] != w; i++);
+	if (i < nstacklist)
+		memmove(&stacklist[i], &stacklist[i + 1], (--nstacklist - i) * sizeof(Window));
+}
+
 void
 tag(const Arg *arg)
 {
 	if (selmon->sel && arg->ui & TAGMASK) {
+		tagcount(selmon->sel, -1);
 		selmon->sel->tags = arg->ui & TAGMASK;
+		tagcount(selmon->sel, 1);
 		focus(NULL);
 		arrange(selmon);
 	}
 }
 
+/* Adds c to (d = 1) or removes it from (d = -1) the counts of its monitor,
+ * around any change of its monitor, tags or urgency. */
+void
+tagcount(Client *c, int d)
+{
+	Monitor *m = c->mon;
+	unsigned int i;
+
+	m->nclients += d;
+	for (i = 0; i < LENGTH(tags); i++) {
+		if (!(c->tags & 1 << i))
+			continue;
+		m->ntagged[i] += d;
+		m->occ = m->ntagged[i] ? m->occ | 1 << i : m->occ & ~(1 << i);
+		if (c->isurgent) {
+			m->nurgent[i] += d;
+			m->urg = m->nurgent[i] ? m->urg | 1 << i : m->urg & ~(1 << i);
+		}
+	}
+	m->tiledstale = 1;
+}
+
 void
 tagmon(const Arg *arg)
 {
@@ -1834,29 +3916,33 @@ tagmon(const Arg *arg)
 void
 tile(Monitor *m)
 {
-	unsigned int i, n, h, mw, my, ty;
-	Client *c;
-
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++);
-	if (n == 0)
-		return;
+	arrangetiled(m, lt_tile);
+}
 
-	if (n > m->nmaster)
-		mw = m->nmaster ? m->ww * m->mfact : 0;
-	else
-		mw = m->ww - m->gap->gappx;
-	for (i = 0, my = ty = m->gap->gappx, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
-		if (i < m->nmaster) {
-			h = (m->wh - my) / (MIN(n, m->nmaster) - i) - m->gap->gappx;
-			resize(c, m->wx + m->gap->gappx, m->wy + my, mw - (2*c->bw) - m->gap->gappx, h - (2*c->bw), 0);
-			if (my + HEIGHT(c) + m->gap->gappx < m->wh)
-				my += HEIGHT(c) + m->gap->gappx;
-		} else {
-			h = (m->wh - ty) / (n - i) - m->gap->gappx;
-			resize(c, m->wx + mw + m->gap->gappx, m->wy + ty, m->ww - mw - (2*c->bw) - 2*m->gap->gappx, h - (2*c->bw), 0);
-			if (ty + HEIGHT(c) + m->gap->gappx < m->wh)
-				ty += HEIGHT(c) + m->gap->gappx;
+/* Copies up to n bytes of a title into dst (TITLEMAX bytes) as UTF-8,
+ * converting from Latin-1 if asked. A cut never splits a character. */
+unsigned int
+titlecpy(char *dst, const unsigned char *s, unsigned long n, int latin1)
+{
+	unsigned int len = 0;
+	unsigned long i;
+
+	for (i = 0; i < n && s[i]; i++) {
+		if (latin1 && s[i] >= 0x80) {
+			if (len + 2 >= TITLEMAX)
+				break;
+			dst[len++] = 0xc0 | s[i] >> 6;
+			dst[len++] = 0x80 | (s[i] & 0x3f);
+		} else if (len + 1 < TITLEMAX)
+			dst[len++] = s[i];
+		else {
+			for (; !latin1 && len && (s[i] & 0xc0) == 0x80; i--)
+				len--;
+			break;
 		}
+	}
+	dst[len] = '\0';
+	return len;
 }
 
 void
@@ -1876,6 +3962,7 @@ togglefloating(const Arg *arg)
 	if (selmon->sel->isfullscreen) /* no support for fullscreen windows */
 		return;
 	selmon->sel->isfloating = !selmon->sel->isfloating || selmon->sel->isfixed;
+	selmon->tiledstale = 1;
 	if (selmon->sel->isfloating)
 		resize(selmon->sel, selmon->sel->x, selmon->sel->y,
 			selmon->sel->w, selmon->sel->h, 0);
@@ -1891,7 +3978,9 @@ toggletag(const Arg *arg)
 		return;
 	newtags = selmon->sel->tags ^ (arg->ui & TAGMASK);
 	if (newtags) {
+		tagcount(selmon->sel, -1);
 		selmon->sel->tags = newtags;
+		tagcount(selmon->sel, 1);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -1904,8 +3993,254 @@ toggleview(const Arg *arg)
 
 	if (newtagset) {
 		selmon->tagset[selmon->seltags] = newtagset;
+		selmon->tiledstale = 1;
 		focus(NULL);
 		arrange(selmon);
+		ipcevent(IpcEvTag, selmon, NULL, NULL);
+	}
+}
+
+/* Records the name of atom a ahead of the first event of a trace that
+ * holds it, the replay interns it again; predefined atoms are the same on
+ * every server. */
+void
+traceatom(Atom a)
+{
+	XEvent ev;
+	char *name;
+
+	if (a <= XA_LAST_PREDEFINED || tracemap(&traceatoms, a))
+		return;
+	tracebind(&traceatoms, a, a);
+	if (!(name = XGetAtomName(dpy, a)))
+		return;
+	memset(&ev, 0, sizeof ev);
+	ev.xany.serial = TRACEATOM;
+	ev.xany.window = a;
+	snprintf((char *)&ev + sizeof(XAnyEvent), sizeof(XEvent) - sizeof(XAnyEvent),
+		"%s", name);
+	XFree(name);
+	tracewrite(&ev, 0);
+}
+
+/* Maps a recorded id to its replay counterpart, to None unmaps it. */
+void
+tracebind(TraceMap *t, unsigned long from, unsigned long to)
+{
+	TraceId *old = t->ids;
+	unsigned int i, n = t->size;
+
+	if (2 * (t->n + 1) > t->size) {
+		/* rehashing drops the unmapped ones */
+		t->size = n ? 2 * n : 64;
+		t->ids = ecalloc(t->size, sizeof(TraceId));
+		t->n = 0;
+		for (i = 0; i < n; i++)
+			if (old[i].to)
+				tracebind(t, old[i].from, old[i].to);
+		free(old);
+	}
+	for (i = from & (t->size - 1); t->ids[i].from && t->ids[i].from != from;
+	     i = (i + 1) & (t->size - 1));
+	if (!t->ids[i].from)
+		t->n++;
+	t->ids[i].from = from;
+	t->ids[i].to = to;
+}
+
+unsigned long
+tracemap(TraceMap *t, unsigned long from)
+{
+	unsigned int i;
+
+	if (!from || !t->size)
+		return None;
+	for (i = from & (t->size - 1); t->ids[i].from; i = (i + 1) & (t->size - 1))
+		if (t->ids[i].from == from)
+			return t->ids[i].to;
+	return None;
+}
+
+Atom
+tracemapatom(Atom a)
+{
+	return a <= XA_LAST_PREDEFINED ? a : tracemap(&traceatoms, a);
+}
+
+int
+traceread(XEvent *ev, int *flags)
+{
+	uint32_t dt;
+	uint16_t len;
+
+	memset(ev, 0, sizeof(XEvent));
+	if (fread(&dt, sizeof dt, 1, tracein) != 1
+	|| fread(&len, sizeof len, 1, tracein) != 1)
+		return 0;
+	*flags = len & ~TRACELEN;
+	len &= TRACELEN;
+	return len <= sizeof(XEvent) && fread(ev, len, 1, tracein) == 1;
+}
+
+/* Bytes of an event of the type that hold its fields. */
+unsigned int
+tracesize(int type)
+{
+	switch (type) {
+	case 0: return sizeof(XEvent); /* an atom's name follows the XAnyEvent */
+	case KeyPress:
+	case KeyRelease: return sizeof(XKeyEvent);
+	case ButtonPress:
+	case ButtonRelease: return sizeof(XButtonEvent);
+	case MotionNotify: return sizeof(XMotionEvent);
+	case EnterNotify:
+	case LeaveNotify: return sizeof(XCrossingEvent);
+	case FocusIn:
+	case FocusOut: return sizeof(XFocusChangeEvent);
+	case Expose: return sizeof(XExposeEvent);
+	case CreateNotify: return sizeof(XCreateWindowEvent);
+	case DestroyNotify: return sizeof(XDestroyWindowEvent);
+	case UnmapNotify: return sizeof(XUnmapEvent);
+	case MapNotify: return sizeof(XMapEvent);
+	case MapRequest: return sizeof(XMapRequestEvent);
+	case ReparentNotify: return sizeof(XReparentEvent);
+	case ConfigureNotify: return sizeof(XConfigureEvent);
+	case ConfigureRequest: return sizeof(XConfigureRequestEvent);
+	case PropertyNotify: return sizeof(XPropertyEvent);
+	case ClientMessage: return sizeof(XClientMessageEvent);
+	case MappingNotify: return sizeof(XMappingEvent);
+	default: return sizeof(XEvent);
+	}
+}
+
+/* Starts recording the events run() handles to path. A trace is a header
+ * and one record per event: the microseconds since the previous one, the
+ * length with the TRACEBATCH and TRACEMERGED flags, and the bytes of the
+ * XEvent, in the layout of this build. Records of type 0 name the root
+ * window, the bar windows and the atoms events refer to for the replay. */
+void
+tracestart(const char *path)
+{
+	Monitor *m;
+	uint32_t hdr[2] = { 3, sizeof(XEvent) };
+
+	if (!(traceout = fopen(path, "w")))
+		die("dwm: cannot open trace '%s':", path);
+	fwrite("dwmtrace", 8, 1, traceout);
+	fwrite(hdr, sizeof hdr, 1, traceout);
+	clock_gettime(CLOCK_MONOTONIC, &tracelast);
+	tracewin(root, (unsigned long)-1);
+	for (m = mons; m; m = m->next)
+		tracewin(m->barwin, m->num);
+}
+
+/* Records window w of dwm itself, tag is a monitor number or -1 for root. */
+void
+tracewin(Window w, unsigned long tag)
+{
+	XEvent ev;
+
+	memset(&ev, 0, sizeof ev);
+	ev.xany.serial = tag;
+	ev.xany.window = w;
+	tracewrite(&ev, 0);
+}
+
+void
+tracewrite(XEvent *ev, int flags)
+{
+	struct timespec now;
+	long long us;
+	uint32_t dt;
+	uint16_t len;
+
+	if (ev->type == GenericEvent)
+		return; /* the data lives elsewhere */
+	if (ev->type == PropertyNotify)
+		traceatom(ev->xproperty.atom);
+	else if (ev->type == ClientMessage) {
+		traceatom(ev->xclient.message_type);
+		if (ev->xclient.message_type == netatom[NetWMState]) {
+			traceatom(ev->xclient.data.l[1]);
+			traceatom(ev->xclient.data.l[2]);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	us = (now.tv_sec - tracelast.tv_sec) * 1000000LL
+		+ (now.tv_nsec - tracelast.tv_nsec) / 1000;
+	tracelast = now;
+	dt = us > UINT32_MAX ? UINT32_MAX : us;
+	len = tracesize(ev->type) | flags;
+	fwrite(&dt, sizeof dt, 1, traceout);
+	fwrite(&len, sizeof len, 1, traceout);
+	fwrite(ev, len & TRACELEN, 1, traceout);
+}
+
+/* Rewrites the windows and atoms of a recorded event to their replay
+ * counterparts. */
+void
+tracexlate(XEvent *ev)
+{
+	ev->xany.display = dpy;
+	ev->xany.window = tracemap(&tracewins, ev->xany.window);
+	switch (ev->type) {
+	case KeyPress:
+	case KeyRelease:
+		ev->xkey.root = tracemap(&tracewins, ev->xkey.root);
+		ev->xkey.subwindow = tracemap(&tracewins, ev->xkey.subwindow);
+		break;
+	case ButtonPress:
+	case ButtonRelease:
+		ev->xbutton.root = tracemap(&tracewins, ev->xbutton.root);
+		ev->xbutton.subwindow = tracemap(&tracewins, ev->xbutton.subwindow);
+		break;
+	case MotionNotify:
+		ev->xmotion.root = tracemap(&tracewins, ev->xmotion.root);
+		ev->xmotion.subwindow = tracemap(&tracewins, ev->xmotion.subwindow);
+		break;
+	case EnterNotify:
+	case LeaveNotify:
+		ev->xcrossing.root = tracemap(&tracewins, ev->xcrossing.root);
+		ev->xcrossing.subwindow = tracemap(&tracewins, ev->xcrossing.subwindow);
+		break;
+	case CreateNotify:
+		ev->xcreatewindow.window = tracemap(&tracewins, ev->xcreatewindow.window);
+		break;
+	case DestroyNotify:
+		ev->xdestroywindow.window = tracemap(&tracewins, ev->xdestroywindow.window);
+		break;
+	case UnmapNotify:
+		ev->xunmap.window = tracemap(&tracewins, ev->xunmap.window);
+		break;
+	case MapNotify:
+		ev->xmap.window = tracemap(&tracewins, ev->xmap.window);
+		break;
+	case MapRequest:
+		ev->xmaprequest.window = tracemap(&tracewins, ev->xmaprequest.window);
+		break;
+	case ReparentNotify:
+		ev->xreparent.window = tracemap(&tracewins, ev->xreparent.window);
+		ev->xreparent.parent = tracemap(&tracewins, ev->xreparent.parent);
+		break;
+	case ConfigureNotify:
+		ev->xconfigure.window = tracemap(&tracewins, ev->xconfigure.window);
+		ev->xconfigure.above = tracemap(&tracewins, ev->xconfigure.above);
+		break;
+	case ConfigureRequest:
+		ev->xconfigurerequest.window = tracemap(&tracewins, ev->xconfigurerequest.window);
+		ev->xconfigurerequest.above = tracemap(&tracewins, ev->xconfigurerequest.above);
+		break;
+	case PropertyNotify:
+		ev->xproperty.atom = tracemapatom(ev->xproperty.atom);
+		break;
+	case ClientMessage:
+		ev->xclient.message_type = tracemapatom(ev->xclient.message_type);
+		if (ev->xclient.message_type == netatom[NetWMState]) {
+			ev->xclient.data.l[1] = tracemapatom(ev->xclient.data.l[1]);
+			ev->xclient.data.l[2] = tracemapatom(ev->xclient.data.l[2]);
+		} else if (ev->xclient.message_type == netatom[NetActiveWindow])
+			ev->xclient.data.l[2] = tracemap(&tracewins, ev->xclient.data.l[2]);
+		break;
 	}
 }
 
@@ -1928,8 +4263,13 @@ unmanage(Client *c, int destroyed)
 	Monitor *m = c->mon;
 	XWindowChanges wc;
 
+	ipcevent(IpcEvClient, m, c, "remove");
+	unstack(m, c->win);
+	winmoved = 1;
+	tagcount(c, -1);
 	detach(c);
 	detachstack(c);
+	updateclientlist(c->win, 0);
 	if (!destroyed) {
 		wc.border_width = c->oldbw;
 		XGrabServer(dpy); /* avoid race conditions */
@@ -1941,9 +4281,9 @@ unmanage(Client *c, int destroyed)
 		XSetErrorHandler(xerror);
 		XUngrabServer(dpy);
 	}
-	free(c);
+	free(c->name);
+	pool_free(&clientpool, c);
 	focus(NULL);
-	updateclientlist();
 	arrange(m);
 }
 
@@ -1954,13 +4294,26 @@ unmapnotify(XEvent *e)
 	XUnmapEvent *ev = &e->xunmap;
 
 	if ((c = wintoclient(ev->window))) {
-		if (ev->send_event)
+		if (ev->send_event && !c->hidden)
 			setclientstate(c, WithdrawnState);
-		else
+		else /* a hidden client announces its withdrawal this way */
 			unmanage(c, 0);
 	}
 }
 
+/* Forgets w in the stacked order of m once it leaves the monitor. */
+void
+unstack(Monitor *m, Window w)
+{
+	int i;
+
+	for (i = 0; i < m->nstacked && m->stacked[i] != w; i++);
+	if (i == m->nstacked)
+		return;
+	m->nstacked--;
+	memmove(&m->stacked[i], &m->stacked[i + 1], (m->nstacked - i) * sizeof(Window));
+}
+
 void
 updatebars(void)
 {
@@ -1972,6 +4325,11 @@ updatebars(void)
 	};
 	XClassHint ch = {"dwm", "dwm"};
 	for (m = mons; m; m = m->next) {
+		if (!m->barbuf || m->barbuf->w != m->ww) {
+			drw_surf_free(drw, m->barbuf);
+			m->barbuf = drw_surf_create(drw, m->ww, bh);
+			m->bardrawn = 0;
+		}
 		if (m->barwin)
 			continue;
 		m->barwin = XCreateWindow(dpy, root, m->wx + sp, m->by + vp, m->ww - 2 * sp, bh, 0, DefaultDepth(dpy, screen),
@@ -1979,7 +4337,10 @@ updatebars(void)
 				CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
 		XDefineCursor(dpy, m->barwin, cursor[CurNormal]->cursor);
 		XMapRaised(dpy, m->barwin);
+		stackplace(m->barwin, None);
 		XSetClassHint(dpy, m->barwin, &ch);
+		if (traceout)
+			tracewin(m->barwin, m->num);
 	}
 }
 
@@ -1996,33 +4357,76 @@ updatebarpos(Monitor *m)
 		m->by = -bh - vp;
 }
 
+/* Keeps clientlist in sync with the managed windows and publishes it as
+ * _NET_CLIENT_LIST, a single request either way. */
 void
-updateclientlist()
+updateclientlist(Window w, int add)
 {
-	Client *c;
+	unsigned int i;
+
+	if (add) {
+		if (nclientlist == clientlistsize) {
+			clientlistsize = MAX(2 * clientlistsize, 32);
+			if (!(clientlist = realloc(clientlist, clientlistsize * sizeof(Window))))
+				die("realloc:");
+		}
+		clientlist[nclientlist++] = w;
+		stackplace(w, None); /* a new window is created on top */
+		XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32,
+			PropModeAppend, (unsigned char *) &w, 1);
+	} else {
+		for (i = 0; i < nclientlist && clientlist[i] != w; i++);
+		if (i == nclientlist)
+			return;
+		memmove(&clientlist[i], &clientlist[i + 1], (--nclientlist - i) * sizeof(Window));
+		stackremove(w);
+		XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32,
+			PropModeReplace, (unsigned char *) clientlist, nclientlist);
+	}
+	updateclientstacking();
+}
+
+/* Publishes the managed windows of stacklist, which is the order on the
+ * server, as _NET_CLIENT_LIST_STACKING if it differs from the last one. */
+void
+updateclientstacking(void)
+{
+	unsigned int i, n, same = 1;
 	Monitor *m;
 
-	XDeleteProperty(dpy, root, netatom[NetClientList]);
-	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			XChangeProperty(dpy, root, netatom[NetClientList],
-				XA_WINDOW, 32, PropModeAppend,
-				(unsigned char *) &(c->win), 1);
+	for (i = n = 0; i < nstacklist; i++) {
+		for (m = mons; m && m->barwin != stacklist[i]; m = m->next);
+		if (m)
+			continue;
+		if (n >= nstacksent || stacksent[n] != stacklist[i])
+			same = 0;
+		stacksent[n++] = stacklist[i];
+	}
+	if (same && n == nstacksent)
+		return;
+	nstacksent = n;
+	XChangeProperty(dpy, root, netatom[NetClientListStacking], XA_WINDOW, 32,
+		PropModeReplace, (unsigned char *) stacksent, n);
 }
 
 int
 updategeom(void)
 {
-	int dirty = 0;
+	int dirty = -1;
 
+#ifdef XRANDR
+	if (randrevbase >= 0)
+		dirty = randrgeom();
+#endif /* XRANDR */
 #ifdef XINERAMA
-	if (XineramaIsActive(dpy)) {
+	if (dirty < 0 && XineramaIsActive(dpy)) {
 		int i, j, n, nn;
 		Client *c;
 		Monitor *m;
 		XineramaScreenInfo *info = XineramaQueryScreens(dpy, &nn);
 		XineramaScreenInfo *unique = NULL;
 
+		dirty = 0;
 		for (n = 0, m = mons; m; m = m->next, n++);
 		/* only consider unique geometries as separate screens */
 		unique = ecalloc(nn, sizeof(XineramaScreenInfo));
@@ -2057,11 +4461,12 @@ updategeom(void)
 				for (m = mons; m && m->next; m = m->next);
 				while ((c = m->clients)) {
 					dirty = 1;
-					m->clients = c->next;
+					detach(c);
 					detachstack(c);
 					c->mon = mons;
 					attach(c);
 					attachstack(c);
+					tagcount(c, 1);
 				}
 				if (m == selmon)
 					selmon = mons;
@@ -2071,7 +4476,8 @@ updategeom(void)
 		free(unique);
 	} else
 #endif /* XINERAMA */
-	{ /* default monitor setup */
+	if (dirty < 0) { /* default monitor setup */
+		dirty = 0;
 		if (!mons)
 			mons = createmon();
 		if (mons->mw != sw || mons->mh != sh) {
@@ -2081,6 +4487,7 @@ updategeom(void)
 			updatebarpos(mons);
 		}
 	}
+	updatemonindex();
 	if (dirty) {
 		selmon = mons;
 		selmon = wintomon(root);
@@ -2088,6 +4495,24 @@ updategeom(void)
 	return dirty;
 }
 
+void
+updatemonindex(void)
+{
+	int i, n;
+	Monitor *m;
+
+	for (n = 0, m = mons; m; m = m->next, n++);
+	free(monindex);
+	monindex = ecalloc(n, sizeof(Monitor *));
+	nmonindex = monindexw = 0;
+	for (m = mons; m; m = m->next) {
+		for (i = nmonindex++; i > 0 && monindex[i - 1]->wx > m->wx; i--)
+			monindex[i] = monindex[i - 1];
+		monindex[i] = m;
+		monindexw = MAX(monindexw, m->ww);
+	}
+}
+
 void
 updatenumlockmask(void)
 {
@@ -2113,38 +4538,7 @@ updatesizehints(Client *c)
 	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
-	if (size.flags & PBaseSize) {
-		c->basew = size.base_width;
-		c->baseh = size.base_height;
-	} else if (size.flags & PMinSize) {
-		c->basew = size.min_width;
-		c->baseh = size.min_height;
-	} else
-		c->basew = c->baseh = 0;
-	if (size.flags & PResizeInc) {
-		c->incw = size.width_inc;
-		c->inch = size.height_inc;
-	} else
-		c->incw = c->inch = 0;
-	if (size.flags & PMaxSize) {
-		c->maxw = size.max_width;
-		c->maxh = size.max_height;
-	} else
-		c->maxw = c->maxh = 0;
-	if (size.flags & PMinSize) {
-		c->minw = size.min_width;
-		c->minh = size.min_height;
-	} else if (size.flags & PBaseSize) {
-		c->minw = size.base_width;
-		c->minh = size.base_height;
-	} else
-		c->minw = c->minh = 0;
-	if (size.flags & PAspect) {
-		c->mina = (float)size.min_aspect.y / size.min_aspect.x;
-		c->maxa = (float)size.max_aspect.x / size.max_aspect.y;
-	} else
-		c->maxa = c->mina = 0.0;
-	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
+	setsizehints(c, &size);
 }
 
 void
@@ -2152,28 +4546,58 @@ updatestatus(void)
 {
 	if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
 		strcpy(stext, "dwm-"VERSION);
-	drawbar(selmon);
+	drawbarparts(selmon, BarStatus);
 }
 
+/* Rebuilds the visible and tiled clients of m, in list order, if anything
+ * they depend on changed since the last call. A view change does walk all
+ * clients of m once; per-tag lists would avoid that but cannot keep the
+ * list order of clients on several tags without an order key per client,
+ * while the layouts, drawbar() and focusstack() after it read only these
+ * arrays. A view of tags nobody is on is answered from the occ mask. */
 void
+updatetiled(Monitor *m)
+{
+	Client *c;
+
+	if (!m->tiledstale)
+		return;
+	m->tiledstale = 0;
+	if (!(m->occ & m->tagset[m->seltags])) {
+		m->nvisible = m->ntiled = 0;
+		return;
+	}
+	if (m->nclients > m->tiledsize) {
+		m->tiledsize = m->nclients + 16;
+		free(m->visible);
+		free(m->tiled);
+		m->visible = ecalloc(m->tiledsize, sizeof(Client *));
+		m->tiled = ecalloc(m->tiledsize, sizeof(Client *));
+	}
+	m->nvisible = m->ntiled = 0;
+	for (c = m->clients; c; c = c->next)
+		if (ISVISIBLE(c)) {
+			m->visible[m->nvisible++] = c;
+			if (!c->isfloating)
+				m->tiled[m->ntiled++] = c;
+		}
+}
+
+int
 updatetitle(Client *c)
 {
-	if (!gettextprop(c->win, netatom[NetWMName], c->name, sizeof c->name))
-		gettextprop(c->win, XA_WM_NAME, c->name, sizeof c->name);
-	if (c->name[0] == '\0') /* hack to mark broken clients */
-		strcpy(c->name, broken);
+	char name[TITLEMAX];
+	unsigned int len;
+
+	len = gettitle(c->win, name);
+	return settitle(c, name, len);
 }
 
 void
 updatewindowtype(Client *c)
 {
-	Atom state = getatomprop(c, netatom[NetWMState]);
-	Atom wtype = getatomprop(c, netatom[NetWMWindowType]);
-
-	if (state == netatom[NetWMFullscreen])
-		setfullscreen(c, 1);
-	if (wtype == netatom[NetWMWindowTypeDialog])
-		c->isfloating = 1;
+	setwindowtype(c, getatomprop(c->win, netatom[NetWMState]),
+		getatomprop(c->win, netatom[NetWMWindowType]));
 }
 
 void
@@ -2182,15 +4606,7 @@ updatewmhints(Client *c)
 	XWMHints *wmh;
 
 	if ((wmh = XGetWMHints(dpy, c->win))) {
-		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints(dpy, c->win, wmh);
-		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
-		else
-			c->neverfocus = 0;
+		setwmhints(c, wmh);
 		XFree(wmh);
 	}
 }
@@ -2203,8 +4619,10 @@ view(const Arg *arg)
 	selmon->seltags ^= 1; /* toggle sel tagset */
 	if (arg->ui & TAGMASK)
 		selmon->tagset[selmon->seltags] = arg->ui & TAGMASK;
+	selmon->tiledstale = 1;
 	focus(NULL);
 	arrange(selmon);
+	ipcevent(IpcEvTag, selmon, NULL, NULL);
 }
 
 Client *
@@ -2366,24 +4784,37 @@ void spawn_status(void) {
 }
 
 int main(int argc, char *argv[]) {
+	const char *record = NULL, *play = NULL;
+
 	if (argc == 2 && !strcmp("-v", argv[1]))
 		die("dwm-"VERSION);
+	else if (argc == 3 && !strcmp("-r", argv[1]))
+		record = argv[2];
+	else if (argc == 3 && !strcmp("-p", argv[1]))
+		play = argv[2];
 	else if (argc != 1)
-		die("usage: dwm [-v]");
+		die("usage: dwm [-v] [-r trace | -p trace]");
 	if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
 		fputs("warning: no locale support\n", stderr);
 	if (!(dpy = XOpenDisplay(NULL)))
 		die("dwm: cannot open display");
 	checkotherwm();
-	spawn_status();
+	if (!play)
+		spawn_status();
 	setup();
+	if (record)
+		tracestart(record);
 #ifdef __OpenBSD__
-	if (pledge("stdio rpath proc exec", NULL) == -1)
+	if (pledge("stdio rpath proc exec unix", NULL) == -1)
 		die("pledge");
 #endif /* __OpenBSD__ */
 	scan();
-	runautostart();
-	run();
+	if (play)
+		replay(play);
+	else {
+		runautostart();
+		run();
+	}
 	cleanup();
 	XCloseDisplay(dpy);
 	return EXIT_SUCCESS;
@@ -0,0 +1,415 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "ipc.h"
+#include "util.h"
+
+static int
+setnonblock(int fd)
+{
+	int flags;
+
+	if ((flags = fcntl(fd, F_GETFL)) == -1
+	|| fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1
+	|| fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+		return -1;
+	return 0;
+}
+
+Ipc *
+ipc_create(const char *path, void (*handler)(IpcClient *c, char *msg))
+{
+	Ipc *ipc;
+	struct sockaddr_un addr;
+	int fd;
+
+	if (!path || !*path)
+		return NULL;
+	memset(&addr, 0, sizeof(addr));
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "dwm: ipc socket path too long: '%s'\n", path);
+		return NULL;
+	}
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("dwm: ipc socket");
+		return NULL;
+	}
+	/* a socket left behind is replaced, one somebody answers on is not */
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 || errno == EAGAIN) {
+		fprintf(stderr, "dwm: ipc socket '%s' is in use\n", path);
+		close(fd);
+		return NULL;
+	}
+	if (errno == ECONNREFUSED)
+		unlink(path);
+	close(fd);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("dwm: ipc socket");
+		return NULL;
+	}
+	if (setnonblock(fd) == -1
+	|| bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1
+	|| chmod(path, S_IRUSR | S_IWUSR) == -1
+	|| listen(fd, SOMAXCONN) == -1) {
+		perror("dwm: ipc bind");
+		close(fd);
+		return NULL;
+	}
+
+	ipc = ecalloc(1, sizeof(Ipc));
+	ipc->fd = fd;
+	ipc->path = strdup(path);
+	ipc->handler = handler;
+
+	return ipc;
+}
+
+static void
+client_free(IpcClient *c)
+{
+	close(c->fd);
+	ipc_buf_free(&c->wbuf);
+	free(c->ring);
+	free(c);
+}
+
+void
+ipc_free(Ipc *ipc)
+{
+	IpcClient *c;
+
+	if (!ipc)
+		return;
+	while ((c = ipc->clients)) {
+		ipc->clients = c->next;
+		client_free(c);
+	}
+	close(ipc->fd);
+	if (ipc->path)
+		unlink(ipc->path);
+	free(ipc->path);
+	free(ipc->pfd);
+	free(ipc);
+}
+
+static int
+ring_push(IpcClient *c, const char *msg, size_t len)
+{
+	size_t tail, n;
+
+	if (len > IPC_RINGSIZ - c->evlen)
+		return 0;
+	tail = (c->head + c->evlen) % IPC_RINGSIZ;
+	n = MIN(len, IPC_RINGSIZ - tail);
+	memcpy(c->ring + tail, msg, n);
+	memcpy(c->ring, msg + n, len - n);
+	c->evlen += len;
+	return 1;
+}
+
+/* Tells a subscriber how many events it missed, once its ring has room. */
+static void
+ring_notify(IpcClient *c)
+{
+	char msg[128];
+	int len;
+
+	len = snprintf(msg, sizeof(msg), "{\"event\":\"dropped\",\"count\":%lu,\"total\":%lu}\n",
+		c->drops, c->dropped);
+	if (ring_push(c, msg, len))
+		c->drops = 0;
+}
+
+/* Replies and events are sent in whole lines: a partially sent line, from
+ * either queue, is completed before the other queue gets its turn. */
+static void
+client_flush(IpcClient *c)
+{
+	const char *data;
+	size_t len;
+	ssize_t n;
+	int fromring;
+
+	for (;;) {
+		if (!c->midring && c->wbuf.len) {
+			data = c->wbuf.data;
+			len = c->wbuf.len;
+			fromring = 0;
+		} else if (c->evlen) {
+			data = c->ring + c->head;
+			len = MIN(c->evlen, IPC_RINGSIZ - c->head);
+			fromring = 1;
+		} else
+			break;
+		if ((n = send(c->fd, data, len, MSG_NOSIGNAL)) == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				c->dead = 1;
+			return;
+		}
+		if (fromring) {
+			c->midring = data[n - 1] != '\n';
+			c->head = (c->head + n) % IPC_RINGSIZ;
+			c->evlen -= n;
+			if (!c->evlen && c->drops)
+				ring_notify(c);
+		} else {
+			c->wbuf.len -= n;
+			memmove(c->wbuf.data, c->wbuf.data + n, c->wbuf.len);
+		}
+	}
+}
+
+static void
+client_read(Ipc *ipc, IpcClient *c)
+{
+	char *nl, *msg;
+	ssize_t n;
+
+	if ((n = recv(c->fd, c->rbuf + c->rlen, sizeof(c->rbuf) - c->rlen, 0)) <= 0) {
+		if (n == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK))
+			c->dead = 1;
+		return;
+	}
+	c->rlen += n;
+
+	/* dispatch every complete line, keep the trailing fragment */
+	msg = c->rbuf;
+	while (!c->dead && (nl = memchr(msg, '\n', c->rlen - (msg - c->rbuf)))) {
+		*nl = '\0';
+		if (nl > msg && nl[-1] == '\r')
+			nl[-1] = '\0';
+		if (*msg)
+			ipc->handler(c, msg);
+		msg = nl + 1;
+	}
+	c->rlen -= msg - c->rbuf;
+	memmove(c->rbuf, msg, c->rlen);
+	if (c->rlen == sizeof(c->rbuf)) /* line too long */
+		c->dead = 1;
+}
+
+static void
+accept_clients(Ipc *ipc)
+{
+	IpcClient *c;
+	int fd;
+
+	while ((fd = accept(ipc->fd, NULL, NULL)) != -1) {
+		if (setnonblock(fd) == -1) {
+			close(fd);
+			continue;
+		}
+		c = ecalloc(1, sizeof(IpcClient));
+		c->fd = fd;
+		c->next = ipc->clients;
+		ipc->clients = c;
+	}
+}
+
+/* Sends the events queued since the last call, once per event batch
+ * rather than once per event. */
+void
+ipc_flush(Ipc *ipc)
+{
+	IpcClient *c;
+
+	if (!ipc)
+		return;
+	for (c = ipc->clients; c; c = c->next)
+		if (c->dirty) {
+			c->dirty = 0;
+			client_flush(c);
+		}
+}
+
+/* Waits until the X connection or one of the sockets becomes ready and
+ * serves the sockets. Returns the result of poll(2). */
+int
+ipc_poll(Ipc *ipc, int xfd, int timeout)
+{
+	struct pollfd *pfd, xpfd = { .fd = xfd, .events = POLLIN };
+	IpcClient *c, **tc;
+	size_t i, n;
+	int ret;
+
+	if (!ipc)
+		return poll(&xpfd, 1, timeout);
+
+	for (n = 2, c = ipc->clients; c; c = c->next, n++);
+	if (n > ipc->pfdsize) {
+		free(ipc->pfd);
+		ipc->pfd = ecalloc(n, sizeof(struct pollfd));
+		ipc->pfdsize = n;
+	}
+	pfd = ipc->pfd;
+	pfd[0] = xpfd;
+	pfd[1].fd = ipc->fd;
+	pfd[1].events = POLLIN;
+	for (i = 2, c = ipc->clients; c; c = c->next, i++) {
+		pfd[i].fd = c->fd;
+		pfd[i].events = POLLIN | (c->wbuf.len || c->evlen ? POLLOUT : 0);
+	}
+
+	if ((ret = poll(pfd, n, timeout)) <= 0)
+		return ret;
+
+	/* clients accepted below are polled on the next round */
+	for (i = 2, c = ipc->clients; c; c = c->next, i++) {
+		if (pfd[i].revents & POLLOUT)
+			client_flush(c);
+		if (pfd[i].revents & POLLIN)
+			client_read(ipc, c);
+		else if (pfd[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+			c->dead = 1;
+	}
+	if (pfd[1].revents & POLLIN)
+		accept_clients(ipc);
+
+	for (tc = &ipc->clients; *tc; ) {
+		if ((c = *tc)->dead) {
+			*tc = c->next;
+			client_free(c);
+		} else
+			tc = &c->next;
+	}
+	return ret;
+}
+
+static void
+buf_grow(IpcBuf *b, size_t len)
+{
+	if (b->len + len < b->size)
+		return;
+	b->size = MAX(2 * b->size, b->len + len + 1);
+	if (!(b->data = realloc(b->data, b->size)))
+		die("realloc:");
+}
+
+static void
+buf_append(IpcBuf *b, const char *s, size_t len)
+{
+	buf_grow(b, len);
+	memcpy(b->data + b->len, s, len);
+	b->len += len;
+	b->data[b->len] = '\0';
+}
+
+void
+ipc_send(IpcClient *c, const char *msg, size_t len)
+{
+	if (c->dead)
+		return;
+	if (c->wbuf.len + len > IPC_MAXPENDING) {
+		c->dead = 1;
+		return;
+	}
+	buf_append(&c->wbuf, msg, len);
+	client_flush(c);
+}
+
+void
+ipc_subscribe(IpcClient *c, unsigned int subs)
+{
+	if (subs && !c->ring)
+		c->ring = ecalloc(1, IPC_RINGSIZ);
+	c->subs = subs;
+}
+
+int
+ipc_subscribed(Ipc *ipc, unsigned int ev)
+{
+	IpcClient *c;
+
+	if (ipc)
+		for (c = ipc->clients; c; c = c->next)
+			if (c->subs & ev)
+				return 1;
+	return 0;
+}
+
+/* Queues an event for every subscriber of ev, ipc_flush() sends it. A
+ * subscriber whose ring is full loses the event instead of stalling the
+ * window manager. */
+void
+ipc_event(Ipc *ipc, unsigned int ev, const char *msg, size_t len)
+{
+	IpcClient *c;
+
+	if (!ipc)
+		return;
+	for (c = ipc->clients; c; c = c->next) {
+		if (c->dead || !(c->subs & ev))
+			continue;
+		if (c->drops)
+			ring_notify(c);
+		if (c->drops || !ring_push(c, msg, len)) {
+			c->drops++;
+			c->dropped++;
+			continue;
+		}
+		c->dirty = 1;
+	}
+}
+
+void
+ipc_buf_printf(IpcBuf *b, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+	buf_grow(b, n);
+	va_start(ap, fmt);
+	vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+	va_end(ap);
+	b->len += n;
+}
+
+/* Appends s as a quoted JSON string. */
+void
+ipc_buf_str(IpcBuf *b, const char *s)
+{
+	const char *p;
+	char esc[8];
+
+	buf_append(b, "\"", 1);
+	for (; *s; s = p + 1) {
+		for (p = s; *p && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20; p++);
+		buf_append(b, s, p - s);
+		if (!*p)
+			break;
+		if (*p == '"' || *p == '\\')
+			snprintf(esc, sizeof(esc), "\\%c", *p);
+		else
+			snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)*p);
+		buf_append(b, esc, strlen(esc));
+	}
+	buf_append(b, "\"", 1);
+}
+
+void
+ipc_buf_free(IpcBuf *b)
+{
+	free(b->data);
+	b->data = NULL;
+	b->len = b->size = 0;
+}
@@ -0,0 +1,53 @@
+/* See LICENSE file for copyright and license details. */
+
+#define IPC_MSGSIZ      1024            /* maximum length of one request line */
+#define IPC_MAXPENDING  (1 << 20)       /* unsent bytes before a client is dropped */
+#define IPC_RINGSIZ     (1 << 14)       /* event ring buffer of a subscriber */
+
+typedef struct {
+	char *data;
+	size_t len, size;
+} IpcBuf;
+
+typedef struct IpcClient IpcClient;
+struct IpcClient {
+	int fd;
+	int dead;
+	char rbuf[IPC_MSGSIZ];
+	size_t rlen;
+	IpcBuf wbuf;
+	unsigned int subs;      /* subscribed event classes */
+	char *ring;             /* pending events, complete lines only */
+	size_t head, evlen;
+	int midring;            /* an event line is partially sent */
+	int dirty;              /* events queued since the last ipc_flush() */
+	unsigned long drops;    /* events dropped since the last notice */
+	unsigned long dropped;  /* events dropped in total */
+	IpcClient *next;
+};
+
+typedef struct {
+	int fd;
+	char *path;
+	IpcClient *clients;
+	void (*handler)(IpcClient *c, char *msg);
+	void *pfd;
+	size_t pfdsize;
+} Ipc;
+
+/* Socket abstraction */
+Ipc *ipc_create(const char *path, void (*handler)(IpcClient *c, char *msg));
+void ipc_free(Ipc *ipc);
+int ipc_poll(Ipc *ipc, int xfd, int timeout);
+void ipc_flush(Ipc *ipc);
+
+/* Message functions */
+void ipc_send(IpcClient *c, const char *msg, size_t len);
+void ipc_subscribe(IpcClient *c, unsigned int subs);
+int ipc_subscribed(Ipc *ipc, unsigned int ev);
+void ipc_event(Ipc *ipc, unsigned int ev, const char *msg, size_t len);
+
+/* Buffer functions */
+void ipc_buf_printf(IpcBuf *b, const char *fmt, ...);
+void ipc_buf_str(IpcBuf *b, const char *s);
+void ipc_buf_free(IpcBuf *b);
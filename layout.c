@@ -0,0 +1,172 @@
+/* See LICENSE file for copyright and license details. */
+#include <stddef.h>
+
+#include "layout.h"
+#include "util.h"
+
+/* Sets *po and *pl to piece i of n, g pixels apart, of the span of length
+ * l starting at o; the remainder is spread so the pieces fill it exactly. */
+static void
+span(int i, int n, int o, int l, int g, int *po, int *pl)
+{
+	l -= g * (n - 1);
+	*po = o + i * g + l * i / n;
+	*pl = l * (i + 1) / n - l * i / n;
+}
+
+/* Places client i in the outer rectangle x, y, w, h, at least t->min in
+ * size and honouring its size hints if there are any. */
+static void
+place(const Tiling *t, int i, Rect *r, int x, int y, int w, int h)
+{
+	w = MAX(t->min, w - 2 * t->bw[i]);
+	h = MAX(t->min, h - 2 * t->bw[i]);
+	if (t->hints)
+		lt_hints(t->hints[i], &w, &h);
+	r[i].x = x;
+	r[i].y = y;
+	r[i].w = w;
+	r[i].h = h;
+}
+
+/* Master column in the middle, the stack alternating right and left of it;
+ * with a single stack client the master stays on the left. */
+void
+lt_centeredmaster(const Tiling *t, Rect *r)
+{
+	int i, j, n = t->n, nm, ns, mw, lw, x, w, y, h, col, ncol, g = t->gap;
+	const Rect *a = &t->wa;
+
+	nm = MIN(n, t->nmaster);
+	ns = n - nm;
+	mw = ns ? (nm ? a->w * t->mfact : 0) : a->w - g;
+	lw = ns > 1 ? (a->w - mw) / 2 : 0;
+	for (i = 0; i < n; i++) {
+		if (i < nm) {
+			span(i, nm, a->y + g, a->h - 2 * g, g, &y, &h);
+			place(t, i, r, a->x + lw + g, y, mw - g, h);
+			continue;
+		}
+		j = i - nm;
+		if (ns > 1 && j % 2) { /* left */
+			col = j / 2;
+			ncol = ns / 2;
+			x = a->x + g;
+			w = lw - g;
+		} else { /* right */
+			col = ns > 1 ? j / 2 : 0;
+			ncol = ns > 1 ? (ns + 1) / 2 : 1;
+			x = a->x + lw + mw + g;
+			w = a->w - lw - mw - 2 * g;
+		}
+		span(col, ncol, a->y + g, a->h - 2 * g, g, &y, &h);
+		place(t, i, r, x, y, w, h);
+	}
+}
+
+/* Like lt_tile(), but the stack clients share one place, monocle style. */
+void
+lt_deck(const Tiling *t, Rect *r)
+{
+	int i, n = t->n, nm, mw, y, h, g = t->gap;
+	const Rect *a = &t->wa;
+
+	nm = MIN(n, t->nmaster);
+	mw = n > nm ? (nm ? a->w * t->mfact : 0) : a->w - g;
+	for (i = 0; i < n; i++)
+		if (i < nm) {
+			span(i, nm, a->y + g, a->h - 2 * g, g, &y, &h);
+			place(t, i, r, a->x + g, y, mw - g, h);
+		} else
+			place(t, i, r, a->x + mw + g, a->y + g, a->w - mw - 2 * g, a->h - 2 * g);
+}
+
+/* Rows of equal cells, as many columns as rows or one more; a short last
+ * row spreads its cells over the whole width. */
+void
+lt_grid(const Tiling *t, Rect *r)
+{
+	int i, n = t->n, cols, rows, row, x, y, w, h, g = t->gap;
+	const Rect *a = &t->wa;
+
+	for (cols = 1; cols * cols < n; cols++);
+	rows = (n + cols - 1) / cols;
+	for (i = 0; i < n; i++) {
+		row = i / cols;
+		span(row, rows, a->y + g, a->h - 2 * g, g, &y, &h);
+		span(i % cols, MIN(cols, n - row * cols), a->x + g, a->w - 2 * g, g, &x, &w);
+		place(t, i, r, x, y, w, h);
+	}
+}
+
+/* Applies size hints to a client size of w by ht. */
+void
+lt_hints(const Hints *h, int *w, int *ht)
+{
+	int baseismin;
+
+	/* see last two sentences in ICCCM 4.1.2.3 */
+	baseismin = h->basew == h->minw && h->baseh == h->minh;
+	if (!baseismin) { /* temporarily remove base dimensions */
+		*w -= h->basew;
+		*ht -= h->baseh;
+	}
+	/* adjust for aspect limits */
+	if (h->mina > 0 && h->maxa > 0) {
+		if (h->maxa < (float)*w / *ht)
+			*w = *ht * h->maxa + 0.5;
+		else if (h->mina < (float)*ht / *w)
+			*ht = *w * h->mina + 0.5;
+	}
+	if (baseismin) { /* increment calculation requires this */
+		*w -= h->basew;
+		*ht -= h->baseh;
+	}
+	/* adjust for increment value */
+	if (h->incw)
+		*w -= *w % h->incw;
+	if (h->inch)
+		*ht -= *ht % h->inch;
+	/* restore base dimensions */
+	*w = MAX(*w + h->basew, h->minw);
+	*ht = MAX(*ht + h->baseh, h->minh);
+	if (h->maxw)
+		*w = MIN(*w, h->maxw);
+	if (h->maxh)
+		*ht = MIN(*ht, h->maxh);
+}
+
+void
+lt_monocle(const Tiling *t, Rect *r)
+{
+	int i;
+
+	for (i = 0; i < t->n; i++)
+		place(t, i, r, t->wa.x, t->wa.y, t->wa.w, t->wa.h);
+}
+
+/* Master column on the left, the stack on the right. A client that comes
+ * out shorter because of its size hints leaves the rest to the next. */
+void
+lt_tile(const Tiling *t, Rect *r)
+{
+	int i, n = t->n, h, mw, my, ty, g = t->gap;
+	const Rect *a = &t->wa;
+
+	if (n > t->nmaster)
+		mw = t->nmaster ? a->w * t->mfact : 0;
+	else
+		mw = a->w - g;
+	for (i = 0, my = ty = g; i < n; i++)
+		if (i < t->nmaster) {
+			h = (a->h - my) / (MIN(n, t->nmaster) - i) - g;
+			place(t, i, r, a->x + g, a->y + my, mw - g, h);
+			if (my + r[i].h + 2 * t->bw[i] + g < a->h)
+				my += r[i].h + 2 * t->bw[i] + g;
+		} else {
+			h = (a->h - ty) / (n - i) - g;
+			place(t, i, r, a->x + mw + g, a->y + ty, a->w - mw - 2 * g, h);
+			if (ty + r[i].h + 2 * t->bw[i] + g < a->h)
+				ty += r[i].h + 2 * t->bw[i] + g;
+		}
+}
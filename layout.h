@@ -0,0 +1,33 @@
+/* See LICENSE file for copyright and license details. */
+
+typedef struct {
+	int x, y, w, h;
+} Rect;
+
+/* ICCCM size hints, see lt_hints() */
+typedef struct {
+	float mina, maxa;
+	int basew, baseh, incw, inch, maxw, maxh, minw, minh;
+} Hints;
+
+/* everything a layout places the tiled clients of a monitor from */
+typedef struct {
+	Rect wa;                  /* window area */
+	int gap;                  /* between clients and to the area's edges */
+	int min;                  /* smallest width and height of a client */
+	float mfact;
+	int nmaster;
+	int n;                    /* clients */
+	const int *bw;            /* their border widths */
+	const Hints *const *hints; /* their size hints, NULL to ignore all */
+} Tiling;
+
+/* Layouts fill r with the geometry of each client, borders excluded, size
+ * hints already applied. They do no I/O, the caller applies r as it is. */
+void lt_centeredmaster(const Tiling *t, Rect *r);
+void lt_deck(const Tiling *t, Rect *r);
+void lt_grid(const Tiling *t, Rect *r);
+void lt_monocle(const Tiling *t, Rect *r);
+void lt_tile(const Tiling *t, Rect *r);
+
+void lt_hints(const Hints *h, int *w, int *ht);
@@ -0,0 +1,147 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Checks the geometry the layouts of layout.c compute, without an X
+ * server: over a range of client counts, nmaster, gaps and work areas
+ * every client must lie inside the area, keep its size hints, and the
+ * clients that do not share a place must not overlap. A subset of the
+ * cases must also give exactly the rectangles in test/layout.golden;
+ * 'test/layout -g > test/layout.golden' rewrites it after an intended
+ * change. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../layout.h"
+#include "test.h"
+
+#define MAXN 16
+#define GOLDEN "test/layout.golden"
+
+typedef struct {
+	const char *name;
+	void (*fn)(const Tiling *, Rect *);
+	int disjoint;             /* clients never share a place */
+} Layout;
+
+static const Layout layouts[] = {
+	{ "tile",           lt_tile,           1 },
+	{ "grid",           lt_grid,           1 },
+	{ "deck",           lt_deck,           0 },
+	{ "centeredmaster", lt_centeredmaster, 1 },
+	{ "monocle",        lt_monocle,        0 },
+};
+
+static int
+overlap(const Rect *a, int ab, const Rect *b, int bb)
+{
+	return a->x < b->x + b->w + 2 * bb && b->x < a->x + a->w + 2 * ab
+		&& a->y < b->y + b->h + 2 * bb && b->y < a->y + a->h + 2 * ab;
+}
+
+static void
+check(const Layout *l, const Tiling *t, const Rect *r)
+{
+	const Rect *a = &t->wa;
+	int i, j, nm = t->nmaster < t->n ? t->nmaster : t->n, ok;
+
+	for (i = 0; i < t->n; i++) {
+		ok = r[i].w >= 1 && r[i].h >= 1
+			&& r[i].x >= a->x && r[i].y >= a->y
+			&& r[i].x + r[i].w + 2 * t->bw[i] <= a->x + a->w
+			&& r[i].y + r[i].h + 2 * t->bw[i] <= a->y + a->h;
+		if (ok && t->hints) {
+			const Hints *h = t->hints[i];
+
+			ok = (!h->incw || (r[i].w - h->basew) % h->incw == 0)
+				&& (!h->inch || (r[i].h - h->baseh) % h->inch == 0)
+				&& (!h->maxw || r[i].w <= h->maxw)
+				&& (!h->maxh || r[i].h <= h->maxh);
+		}
+		for (j = 0; ok && j < i; j++)
+			/* deck and monocle stack their clients on one place */
+			if (l->disjoint || (j < nm && l->fn == lt_deck))
+				ok = !overlap(&r[i], t->bw[i], &r[j], t->bw[j]);
+		if (!ok) {
+			fprintf(stderr, "layout: %s n %d nmaster %d gap %d area %dx%d: "
+				"client %d at %d,%d %dx%d\n", l->name, t->n, t->nmaster,
+				t->gap, a->w, a->h, i, r[i].x, r[i].y, r[i].w, r[i].h);
+			CHECK(ok);
+			return;
+		}
+	}
+}
+
+/* Compares the rectangles of a golden case with the next line of the
+ * golden file, or prints them there if gen is set. */
+static void
+golden(FILE *f, int gen, const Layout *l, const Tiling *t, const Rect *r)
+{
+	char want[4096], got[4096];
+	int i, len;
+
+	len = snprintf(got, sizeof(got), "%s n %d nmaster %d gap %d hints %d:",
+		l->name, t->n, t->nmaster, t->gap, t->hints != NULL);
+	for (i = 0; i < t->n; i++)
+		len += snprintf(got + len, sizeof(got) - len, " %d,%d %dx%d",
+			r[i].x, r[i].y, r[i].w, r[i].h);
+	if (gen) {
+		printf("%s\n", got);
+		return;
+	}
+	if (!f || !fgets(want, sizeof(want), f))
+		*want = '\0';
+	want[strcspn(want, "\n")] = '\0';
+	if (strcmp(want, got)) {
+		fprintf(stderr, "layout: %s\n  want %s\n   got %s\n", GOLDEN, want, got);
+		CHECK(!strcmp(want, got));
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const Rect areas[] = {
+		{ 0, 0, 1920, 1080 }, { 1920, 18, 1280, 1006 }, { 0, 0, 3440, 1440 },
+	};
+	static const int gaps[] = { 0, 5, 12 };
+	static const int nmasters[] = { 0, 1, 2, 3 };
+	Hints term = { 0, 0, 2, 2, 7, 15, 0, 0, 16, 32 }, plain = { 0 };
+	const Hints *hints[MAXN];
+	int bw[MAXN];
+	Rect r[MAXN];
+	Tiling t;
+	FILE *f = NULL;
+	size_t l, a, g, m;
+	int i, n, gen = argc > 1 && !strcmp(argv[1], "-g");
+
+	if (!gen && !(f = fopen(GOLDEN, "r")))
+		perror("layout: " GOLDEN);
+	for (i = 0; i < MAXN; i++) {
+		bw[i] = 1;
+		hints[i] = i % 3 ? &plain : &term; /* every third one a terminal */
+	}
+	for (l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++)
+	for (a = 0; a < sizeof(areas) / sizeof(areas[0]); a++)
+	for (g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++)
+	for (m = 0; m < sizeof(nmasters) / sizeof(nmasters[0]); m++)
+	for (n = 1; n <= MAXN; n++)
+	for (i = 0; i < 2; i++) {
+		t.wa = areas[a];
+		t.gap = gaps[g];
+		t.min = 1;
+		t.mfact = 0.55;
+		t.nmaster = nmasters[m];
+		t.n = n;
+		t.bw = bw;
+		t.hints = i ? hints : NULL;
+		layouts[l].fn(&t, r);
+		check(&layouts[l], &t, r);
+		if (a == 0 && g < 2 && m && m < 3 && (n <= 3 || n == 5 || n == 8))
+			golden(f, gen, &layouts[l], &t, r);
+	}
+	if (f)
+		fclose(f);
+	else if (!gen)
+		failures++;
+	return failures != 0;
+}
@@ -0,0 +1,136 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Property test of the client and stack lists: a random series of
+ * attach(), attachafter(), attachstack(), detach() and detachstack() must
+ * leave both lists in the order a plain array model of the old singly
+ * linked code predicts, with every prev pointer matching its next, and
+ * detachstack() must move the selection the same way. Needs no X server. */
+#define main dwm_main
+#include "../dwm.c"
+#undef main
+
+#include "test.h"
+
+#define NCLIENT 64
+#define NSTEP   200000
+
+static Monitor m;
+static Client cs[NCLIENT];
+
+/* the model: indices into cs in list order, and whether each is in it */
+static int clist[NCLIENT], nclist, inclients[NCLIENT];
+static int slist[NCLIENT], nslist, instack[NCLIENT];
+static int msel = -1;
+
+static void
+insert(int *a, int *n, int at, int v)
+{
+	memmove(&a[at + 1], &a[at], (*n - at) * sizeof(int));
+	a[at] = v;
+	(*n)++;
+}
+
+static int
+find(const int *a, int n, int v)
+{
+	int i;
+
+	for (i = 0; i < n && a[i] != v; i++);
+	return i;
+}
+
+static void
+erase(int *a, int *n, int v)
+{
+	int i = find(a, *n, v);
+
+	memmove(&a[i], &a[i + 1], (*n - i - 1) * sizeof(int));
+	(*n)--;
+}
+
+static int
+verify(void)
+{
+	Client *c, *p;
+	int i;
+
+	for (i = 0, p = NULL, c = m.clients; c && i < nclist; p = c, c = c->next, i++)
+		if (c != &cs[clist[i]] || c->prev != p)
+			return 0;
+	if (c || i != nclist)
+		return 0;
+	for (i = 0, p = NULL, c = m.stack; c && i < nslist; p = c, c = c->snext, i++)
+		if (c != &cs[slist[i]] || c->sprev != p)
+			return 0;
+	if (c || i != nslist)
+		return 0;
+	return m.sel == (msel < 0 ? NULL : &cs[msel]);
+}
+
+int
+main(void)
+{
+	int step, i, a, op;
+
+	m.tagset[0] = 1;
+	for (i = 0; i < NCLIENT; i++) {
+		cs[i].mon = &m;
+		cs[i].tags = i % 3 ? 1 : 2; /* every third one on a hidden tag */
+	}
+	srand(1);
+	for (step = 0; step < NSTEP && !failures; step++) {
+		i = rand() % NCLIENT;
+		op = rand() % 5;
+		switch (op) {
+		case 0: /* attach */
+			if (inclients[i])
+				continue;
+			attach(&cs[i]);
+			insert(clist, &nclist, 0, i);
+			inclients[i] = 1;
+			break;
+		case 1: /* attachafter a random member */
+			if (inclients[i] || !nclist)
+				continue;
+			a = clist[rand() % nclist];
+			attachafter(&cs[i], &cs[a]);
+			insert(clist, &nclist, find(clist, nclist, a) + 1, i);
+			inclients[i] = 1;
+			break;
+		case 2:
+			if (!inclients[i])
+				continue;
+			detach(&cs[i]);
+			erase(clist, &nclist, i);
+			inclients[i] = 0;
+			break;
+		case 3: /* attachstack, sometimes selecting it like focus() */
+			if (instack[i])
+				continue;
+			attachstack(&cs[i]);
+			insert(slist, &nslist, 0, i);
+			instack[i] = 1;
+			if (rand() % 2) {
+				m.sel = &cs[i];
+				msel = i;
+			}
+			break;
+		case 4: /* detachstack, the selection moves to the next visible */
+			if (!instack[i])
+				continue;
+			detachstack(&cs[i]);
+			erase(slist, &nslist, i);
+			instack[i] = 0;
+			if (msel == i) {
+				for (a = 0; a < nslist && cs[slist[a]].tags != 1; a++);
+				msel = a < nslist ? slist[a] : -1;
+			}
+			break;
+		}
+		if (!verify()) {
+			fprintf(stderr, "list: step %d, op %d on client %d\n", step, op, i);
+			CHECK(verify());
+		}
+	}
+	return failures != 0;
+}
@@ -0,0 +1,121 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Checks that the RandR backend keeps clients on their named monitor: with
+ * two RandR monitors A and B set up by xrandr --setmonitor, a client on
+ * each must stay where it is when a monitor C is added and removed again,
+ * and the client of B must go to A once B is removed. Runs ./dwm-randr,
+ * dwm built with -DXRANDR, and needs Xvfb and xrandr. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+
+#include "test.h"
+#include "xenv.h"
+
+#define STATESIZE 16384
+
+static char state[STATESIZE];
+
+static int
+sh(const char *cmd)
+{
+	return system(cmd) == 0;
+}
+
+static int
+nmons(void)
+{
+	const char *p;
+	int n = 0;
+
+	for (p = state; (p = strstr(p, "{\"num\":")); p++)
+		n++;
+	return n;
+}
+
+/* waits for dwm to have n monitors, leaves its state in state */
+static int
+waitmons(int n)
+{
+	int i;
+
+	for (i = 0; i < 200; i++) {
+		if (xenv_ipc("get_state", state, sizeof(state)) > 0 && nmons() == n)
+			return 1;
+		xenv_sleep(10000);
+	}
+	return 0;
+}
+
+/* the name of the monitor win is on in state, "" if it is on none */
+static const char *
+monof(Window win)
+{
+	static char name[32];
+	const char *p, *m = NULL, *w;
+	char pat[64];
+	size_t len;
+
+	*name = '\0';
+	snprintf(pat, sizeof(pat), "{\"win\":%lu,", win);
+	if (!(w = strstr(state, pat)))
+		return name;
+	for (p = state; (p = strstr(p, "{\"num\":")) && p < w; p++)
+		m = p;
+	if (!m || !(m = strstr(m, "\"name\":\"")))
+		return name;
+	m += strlen("\"name\":\"");
+	len = strcspn(m, "\"");
+	snprintf(name, sizeof(name), "%.*s", (int)(len < sizeof(name) ? len : sizeof(name) - 1), m);
+	return name;
+}
+
+int
+main(void)
+{
+	char buf[256], ma[32], mb[32];
+	Window a, b;
+
+	if (access("./dwm-randr", X_OK) != 0 || !sh("command -v xrandr >/dev/null 2>&1"))
+		return SKIP;
+	if (!xenv_server())
+		return SKIP;
+	/* A takes the one output of Xvfb, B and later C have none */
+	if (!sh("xrandr --setmonitor A 426/113x1024/271+0+0 screen")
+	|| !sh("xrandr --setmonitor B 426/113x1024/271+426+0 none")) {
+		xenv_stop();
+		return SKIP; /* no RandR 1.5 */
+	}
+	if (!xenv_wm((char *[]){ "./dwm-randr", NULL })) {
+		xenv_stop();
+		return 1;
+	}
+	CHECK(waitmons(2));
+	a = xenv_client("randr a", 200, 100);
+	xenv_ipc("focusmon 1", buf, sizeof(buf));
+	b = xenv_client("randr b", 200, 100);
+	xenv_ipc("get_state", state, sizeof(state));
+	snprintf(ma, sizeof(ma), "%s", monof(a));
+	snprintf(mb, sizeof(mb), "%s", monof(b));
+	CHECK(*ma && *mb && strcmp(ma, mb));
+	CHECK(!strcmp(ma, "A") || !strcmp(ma, "B"));
+
+	sh("xrandr --setmonitor C 428/113x1024/271+852+0 none");
+	CHECK(waitmons(3));
+	CHECK(!strcmp(monof(a), ma));
+	CHECK(!strcmp(monof(b), mb));
+
+	sh("xrandr --delmonitor C");
+	CHECK(waitmons(2));
+	CHECK(!strcmp(monof(a), ma));
+	CHECK(!strcmp(monof(b), mb));
+
+	sh("xrandr --delmonitor B");
+	CHECK(waitmons(1));
+	CHECK(!strcmp(monof(a), "A"));
+	CHECK(!strcmp(monof(b), "A"));
+	xenv_stop();
+	return failures != 0;
+}
@@ -0,0 +1,143 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Checks the stacking order dwm leaves on the server: after each of a
+ * random series of focus and order changes, XQueryTree() must show the
+ * test's windows in the order dwm publishes as _NET_CLIENT_LIST_STACKING,
+ * the focused one on top and all of them below the bar. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "test.h"
+#include "xenv.h"
+
+#define NWIN 8
+
+static Display *dpy;
+static Window wins[NWIN];
+
+static int
+ours(Window w)
+{
+	int i;
+
+	for (i = 0; i < NWIN && wins[i] != w; i++);
+	return i < NWIN;
+}
+
+static int
+isbar(Window w)
+{
+	XClassHint ch;
+	int r = 0;
+
+	if (XGetClassHint(dpy, w, &ch)) {
+		r = ch.res_name && !strcmp(ch.res_name, "dwm");
+		XFree(ch.res_name);
+		XFree(ch.res_class);
+	}
+	return r;
+}
+
+static Window
+active(void)
+{
+	Atom type;
+	int format;
+	unsigned long n, left;
+	unsigned char *p = NULL;
+	Window w = None;
+
+	if (XGetWindowProperty(dpy, DefaultRootWindow(dpy),
+		XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False), 0, 1, False, XA_WINDOW,
+		&type, &format, &n, &left, &p) == Success && p) {
+		if (n)
+			w = *(Window *)p;
+		XFree(p);
+	}
+	return w;
+}
+
+/* our windows bottom to top as published, returns how many */
+static int
+published(Window *out)
+{
+	Atom type;
+	int format, n = 0;
+	unsigned long i, len, left;
+	unsigned char *p = NULL;
+
+	if (XGetWindowProperty(dpy, DefaultRootWindow(dpy),
+		XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False), 0, 1024, False,
+		XA_WINDOW, &type, &format, &len, &left, &p) == Success && p) {
+		for (i = 0; i < len; i++)
+			if (ours(((Window *)p)[i]))
+				out[n++] = ((Window *)p)[i];
+		XFree(p);
+	}
+	return n;
+}
+
+/* returns 1 if the server order agrees with what dwm claims */
+static int
+consistent(int report)
+{
+	Window d1, d2, *kids = NULL, tree[NWIN], pub[NWIN];
+	unsigned int i, nkids;
+	int n = 0, npub, bar = -1, below = 1;
+
+	if (!XQueryTree(dpy, DefaultRootWindow(dpy), &d1, &d2, &kids, &nkids))
+		return 0;
+	for (i = 0; i < nkids; i++) {
+		if (ours(kids[i])) {
+			tree[n++] = kids[i];
+			if (bar >= 0)
+				below = 0;
+		} else if (bar < 0 && isbar(kids[i]))
+			bar = i;
+	}
+	XFree(kids);
+	npub = published(pub);
+	if (!report)
+		return n == NWIN && npub == NWIN && !memcmp(tree, pub, sizeof(tree))
+			&& tree[NWIN - 1] == active() && below;
+	CHECK(n == NWIN);
+	CHECK(npub == NWIN);
+	CHECK(!memcmp(tree, pub, sizeof(tree)));
+	CHECK(tree[NWIN - 1] == active());
+	CHECK(below);
+	return 0;
+}
+
+int
+main(void)
+{
+	static const char *cmds[] = {
+		"focusstack 1", "focusstack -1", "zoom", "pushup", "pushdown",
+		"incnmaster 1", "incnmaster -1", "setlayout 3", "setlayout 0",
+	};
+	char buf[256];
+	int i, j;
+
+	if (!(dpy = xenv_start()))
+		return SKIP;
+	for (i = 0; i < NWIN; i++) {
+		snprintf(buf, sizeof(buf), "restack %d", i);
+		wins[i] = xenv_client(buf, 200, 100);
+	}
+	srand(1);
+	for (i = 0; i < 300 && !failures; i++) {
+		xenv_ipc(cmds[rand() % (sizeof(cmds) / sizeof(cmds[0]))], buf, sizeof(buf));
+		/* dwm flushes before it reads the next request */
+		xenv_ipc("unsubscribe all", buf, sizeof(buf));
+		for (j = 0; j < 100 && !consistent(0); j++)
+			xenv_sleep(10000);
+		if (j == 100)
+			consistent(1);
+	}
+	xenv_stop();
+	return failures != 0;
+}
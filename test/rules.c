@@ -0,0 +1,131 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Checks applyrules() against a plain scan of all rules in order: for
+ * random rule sets mixing exact and glob classes, instances, titles and
+ * window types, every window must end up with the same tags, floating
+ * state and monitor. Needs no X server. */
+#define main dwm_main
+#include "../dwm.c"
+#undef main
+
+#include "test.h"
+
+#define NRULE 64
+#define NSET  300
+#define NWIN  300
+
+static const char *classes[] = {
+	NULL, "Gimp", "Firefox", "St", "XTerm", "mpv", "*", "X*", "?t", "[GF]*",
+	"*e*", "Gimp*",
+};
+static const char *names[] = {
+	"Gimp", "Firefox", "St", "XTerm", "mpv", "Xephyr", "gimp", "",
+};
+static const char *titles[] = {
+	NULL, NULL, NULL, "vim", "*vim*", "Mozilla*",
+};
+static const char *titlenames[] = {
+	"vim", "~/src - vim", "Mozilla Firefox", "htop", "",
+};
+static const char *wintypes[] = {
+	NULL, NULL, NULL, "_NET_WM_WINDOW_TYPE_DIALOG", "_NET_WM_WINDOW_TYPE_UTILITY",
+};
+
+static Monitor mon0, mon1;
+static Rule set[NRULE];
+
+#define PICK(a) (a[rand() % LENGTH(a)])
+
+/* stands in for atomsintern(), the atom of a name is its index */
+static Atom
+typeatom(const char *name)
+{
+	Atom i;
+
+	for (i = 1; i < LENGTH(wintypes) && (!wintypes[i] || strcmp(wintypes[i], name)); i++);
+	return i;
+}
+
+static void
+fakeintern(void)
+{
+	int i;
+
+	for (i = 0; i < natomreqs; i++)
+		*atomreqs[i].atom = typeatom(atomreqs[i].name);
+	natomreqs = 0;
+}
+
+/* what applyrules() did before it was compiled */
+static void
+naive(Client *c, Props *p, int n)
+{
+	int i;
+
+	c->isfloating = 0;
+	c->tags = 0;
+	for (i = 0; i < n; i++)
+		if (rulematch(set[i].class, p->class)
+		&& rulematch(set[i].instance, p->instance)
+		&& rulematch(set[i].title, c->name)
+		&& (!set[i].wintype || typeatom(set[i].wintype) == p->wtype))
+		{
+			c->isfloating = set[i].isfloating;
+			c->tags |= set[i].tags;
+			if (set[i].monitor == 0 || set[i].monitor == 1)
+				c->mon = set[i].monitor ? &mon1 : &mon0;
+		}
+}
+
+int
+main(void)
+{
+	static Props p;
+	Client a, b;
+	char title[64];
+	int s, w, i, n;
+
+	mon0.next = &mon1;
+	mon1.num = 1;
+	mons = &mon0;
+	srand(1);
+	for (s = 0; s < NSET && !failures; s++) {
+		n = rand() % (NRULE + 1);
+		for (i = 0; i < n; i++) {
+			set[i].class = PICK(classes);
+			set[i].instance = rand() % 4 ? NULL : PICK(names);
+			set[i].title = PICK(titles);
+			set[i].wintype = PICK(wintypes);
+			set[i].tags = 1 << rand() % 9;
+			set[i].isfloating = rand() % 2;
+			set[i].monitor = rand() % 4 - 2;
+		}
+		free(rulebuckets);
+		free(rulenext);
+		free(ruleglob);
+		free(ruletypes);
+		compilerules(set, n);
+		fakeintern();
+		for (w = 0; w < NWIN; w++) {
+			snprintf(p.class, sizeof(p.class), "%s", PICK(names));
+			snprintf(p.instance, sizeof(p.instance), "%s", PICK(names));
+			snprintf(title, sizeof(title), "%s", PICK(titlenames));
+			p.wtype = rand() % LENGTH(wintypes); /* 3 and 4 are the rule types */
+			memset(&a, 0, sizeof(a));
+			a.mon = &mon0;
+			a.name = title;
+			b = a;
+			applyrules(&a, &p);
+			naive(&b, &p, n);
+			if (a.tags != b.tags || a.isfloating != b.isfloating || a.mon != b.mon) {
+				fprintf(stderr, "rules: set %d of %d rules, window %s/%s/%s type %lu\n",
+					s, n, p.class, p.instance, title, p.wtype);
+				CHECK(a.tags == b.tags);
+				CHECK(a.isfloating == b.isfloating);
+				CHECK(a.mon == b.mon);
+				break;
+			}
+		}
+	}
+	return failures != 0;
+}
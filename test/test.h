@@ -0,0 +1,14 @@
+/* See LICENSE file for copyright and license details. */
+
+/* Checks for the programs in test/, run by 'make test'. A test exits 0 when
+ * all checks passed, 1 when one failed and SKIP when it cannot run here. */
+#define SKIP 77
+
+#define CHECK(c) do { \
+	if (!(c)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #c); \
+		failures++; \
+	} \
+} while (0)
+
+static int failures;
@@ -0,0 +1,134 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Checks that a replay does what the recording did: records a short
+ * session on Xvfb with dwm -r, clients mapped, renamed, made fullscreen
+ * and destroyed while the pointer moves over the root window, then
+ * replays it with dwm -p on the emptied server. The replay must end with
+ * as many managed clients as the recording and report the same event and
+ * root motion counters as get_stats did at its end. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+
+#include "test.h"
+#include "xenv.h"
+
+#define NWIN 6
+
+static Display *dpy;
+
+static void
+fullscreen(Window w)
+{
+	XEvent ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.xclient.type = ClientMessage;
+	ev.xclient.window = w;
+	ev.xclient.message_type = XInternAtom(dpy, "_NET_WM_STATE", False);
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = 1; /* _NET_WM_STATE_ADD */
+	ev.xclient.data.l[1] = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+	XSendEvent(dpy, DefaultRootWindow(dpy), False,
+		SubstructureNotifyMask|SubstructureRedirectMask, &ev);
+}
+
+/* waits until dwm has nothing left of what was sent so far, leaves its
+ * last get_stats reply in buf */
+static void
+quiesce(char *buf, size_t size)
+{
+	long events = -1;
+
+	XSync(dpy, False);
+	for (;;) {
+		xenv_ipc("get_stats", buf, size);
+		if (xenv_statof(buf, "x", "events") == events)
+			return;
+		events = xenv_statof(buf, "x", "events");
+		xenv_sleep(20000);
+	}
+}
+
+static int
+nclients(const char *state)
+{
+	const char *p;
+	int n = 0;
+
+	for (p = state; (p = strstr(p, "{\"win\":")); p++)
+		n++;
+	return n;
+}
+
+int
+main(void)
+{
+	static char state[16384];
+	char trace[] = "/tmp/dwmtrace.XXXXXX", out[] = "/tmp/dwmreplay.XXXXXX";
+	char stats[1024], line[1024], cmd[256], replayed[1024] = "", title[64];
+	Window wins[NWIN];
+	FILE *f;
+	int i, j, fd, n = -1;
+
+	if (!(dpy = xenv_server()))
+		return SKIP;
+	if ((fd = mkstemp(trace)) == -1 || close(fd) || (fd = mkstemp(out)) == -1 || close(fd)) {
+		xenv_stop();
+		return 1;
+	}
+	if (!xenv_wm((char *[]){ "./dwm", "-r", trace, NULL })) {
+		xenv_stop();
+		return 1;
+	}
+	for (i = 0; i < NWIN; i++) {
+		snprintf(title, sizeof(title), "trace %d", i);
+		wins[i] = xenv_client(title, 300, 200);
+		/* bursts of root motion, some of it coalesced */
+		for (j = 0; j < 20; j++)
+			XWarpPointer(dpy, None, DefaultRootWindow(dpy), 0, 0, 0, 0,
+				100 + 40 * i + j, 100 + 7 * j);
+		XFlush(dpy);
+	}
+	for (i = 0; i < NWIN; i++) {
+		snprintf(title, sizeof(title), "trace %d renamed", i);
+		XStoreName(dpy, wins[i], title);
+	}
+	fullscreen(wins[1]);
+	XDestroyWindow(dpy, wins[2]);
+	XDestroyWindow(dpy, wins[4]);
+	quiesce(stats, sizeof(stats));
+	xenv_ipc("get_state", state, sizeof(state));
+	xenv_wmstop();
+	/* the replay recreates the clients on an empty server */
+	for (i = 0; i < NWIN; i++)
+		if (i != 2 && i != 4)
+			XDestroyWindow(dpy, wins[i]);
+	XSync(dpy, False);
+
+	snprintf(cmd, sizeof(cmd), "./dwm -p %s 2>%s", trace, out);
+	CHECK(system(cmd) == 0);
+	if ((f = fopen(out, "r"))) {
+		while (fgets(line, sizeof(line), f))
+			if (!strncmp(line, "dwm: replayed ", 14))
+				sscanf(strrchr(line, ',') + 1, "%d", &n);
+			else if (!strncmp(line, "dwm: stats ", 11))
+				snprintf(replayed, sizeof(replayed), "%s", line + 11);
+		fclose(f);
+	}
+	CHECK(nclients(state) == NWIN - 2);
+	CHECK(n == nclients(state));
+	CHECK(*replayed);
+	CHECK(xenv_statof(replayed, "x", "events") == xenv_statof(stats, "x", "events"));
+	CHECK(xenv_statof(replayed, "motion", "events") == xenv_statof(stats, "motion", "events"));
+	CHECK(xenv_statof(replayed, "motion", "coalesced") == xenv_statof(stats, "motion", "coalesced"));
+	CHECK(xenv_statof(replayed, "motion", "lookups") == xenv_statof(stats, "motion", "lookups"));
+	if (failures)
+		fprintf(stderr, "trace: recorded %s\ntrace: replayed %s\n", stats, replayed);
+	unlink(trace);
+	unlink(out);
+	xenv_stop();
+	return failures != 0;
+}
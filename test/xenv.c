@@ -0,0 +1,249 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "xenv.h"
+
+static Display *dpy;
+static pid_t xvfb, dwm;
+static int ipcfd = -1;
+static char rundir[] = "/tmp/dwmtest.XXXXXX";
+static char sockpath[108];
+
+void
+xenv_sleep(long us)
+{
+	struct timespec ts = { us / 1000000, us % 1000000 * 1000 };
+
+	nanosleep(&ts, NULL);
+}
+
+static int
+inpath(const char *cmd)
+{
+	char *path, *dir, buf[4096];
+
+	if (!(path = getenv("PATH")) || !(path = strdup(path)))
+		return 0;
+	for (dir = strtok(path, ":"); dir; dir = strtok(NULL, ":")) {
+		snprintf(buf, sizeof(buf), "%s/%s", dir, cmd);
+		if (access(buf, X_OK) == 0)
+			break;
+	}
+	free(path);
+	return dir != NULL;
+}
+
+static pid_t
+run(char *const argv[])
+{
+	pid_t pid;
+
+	if ((pid = fork()) == 0) {
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	return pid;
+}
+
+Display *
+xenv_start(void)
+{
+	if (!xenv_server())
+		return NULL;
+	if (!xenv_wm((char *[]){ "./dwm", NULL })) {
+		xenv_stop();
+		return NULL;
+	}
+	return dpy;
+}
+
+Display *
+xenv_server(void)
+{
+	char name[16], lock[32];
+	int i, n;
+
+	if (!inpath("Xvfb"))
+		return NULL;
+	for (n = 90; n < 190; n++) {
+		snprintf(lock, sizeof(lock), "/tmp/.X%d-lock", n);
+		if (access(lock, F_OK) != 0)
+			break;
+	}
+	snprintf(name, sizeof(name), ":%d", n);
+	xvfb = run((char *[]){ "Xvfb", name, "-screen", "0", "1280x1024x24",
+		"-nolisten", "tcp", NULL });
+	for (i = 0; i < 100 && !(dpy = XOpenDisplay(name)); i++)
+		xenv_sleep(50000);
+	if (!dpy) {
+		fprintf(stderr, "xenv: Xvfb on %s did not come up\n", name);
+		xenv_stop();
+		return NULL;
+	}
+	if (!mkdtemp(rundir)) {
+		perror("xenv: mkdtemp");
+		xenv_stop();
+		return NULL;
+	}
+	setenv("DISPLAY", name, 1);
+	setenv("XDG_RUNTIME_DIR", rundir, 1);
+	snprintf(sockpath, sizeof(sockpath), "%s/dwm-%s.sock", rundir, name);
+	return dpy;
+}
+
+int
+xenv_wm(char *const argv[])
+{
+	struct sockaddr_un addr;
+	int i;
+
+	if (access(argv[0], X_OK) != 0)
+		return 0;
+	dwm = run(argv);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, sockpath);
+	/* fine grained, bench/scan times this */
+	for (i = 0; i < 2000; i++) {
+		if ((ipcfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+			break;
+		if (connect(ipcfd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+			return 1;
+		close(ipcfd);
+		ipcfd = -1;
+		xenv_sleep(2500);
+	}
+	fprintf(stderr, "xenv: %s did not open %s\n", argv[0], sockpath);
+	xenv_wmstop();
+	return 0;
+}
+
+void
+xenv_wmstop(void)
+{
+	char buf[64];
+
+	if (ipcfd >= 0) {
+		xenv_ipc("quit", buf, sizeof(buf));
+		close(ipcfd);
+		ipcfd = -1;
+	}
+	if (dwm > 0) {
+		kill(dwm, SIGTERM);
+		waitpid(dwm, NULL, 0);
+		dwm = 0;
+	}
+}
+
+void
+xenv_stop(void)
+{
+	xenv_wmstop();
+	if (dpy) {
+		XCloseDisplay(dpy);
+		dpy = NULL;
+	}
+	if (xvfb > 0) {
+		kill(xvfb, SIGTERM);
+		waitpid(xvfb, NULL, 0);
+		xvfb = 0;
+	}
+	if (*sockpath) {
+		unlink(sockpath);
+		rmdir(rundir);
+	}
+}
+
+int
+xenv_ipc(const char *req, char *buf, size_t size)
+{
+	size_t len = 0;
+	ssize_t r;
+
+	if (dprintf(ipcfd, "%s\n", req) < 0)
+		return -1;
+	while (len + 1 < size) {
+		if ((r = read(ipcfd, buf + len, 1)) <= 0) {
+			if (r < 0 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (buf[len] == '\n')
+			break;
+		len++;
+	}
+	buf[len] = '\0';
+	return len;
+}
+
+Window
+xenv_client(const char *title, int w, int h)
+{
+	Window win;
+
+	win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, w, h, 0, 0, 0);
+	XStoreName(dpy, win, title);
+	XMapWindow(dpy, win);
+	if (!xenv_managed(win))
+		fprintf(stderr, "xenv: window '%s' was not managed\n", title);
+	return win;
+}
+
+int
+xenv_managed(Window win)
+{
+	Atom wmstate = XInternAtom(dpy, "WM_STATE", False), type;
+	unsigned long n, left;
+	unsigned char *p = NULL;
+	int i, format;
+
+	/* dwm sets WM_STATE once it manages the window */
+	for (i = 0; i < 200; i++) {
+		if (XGetWindowProperty(dpy, win, wmstate, 0, 2, False, wmstate,
+			&type, &format, &n, &left, &p) == Success && p) {
+			XFree(p);
+			if (n)
+				return 1;
+		}
+		xenv_sleep(10000);
+	}
+	return 0;
+}
+
+long
+xenv_stat(const char *section, const char *key)
+{
+	char buf[1024];
+
+	if (xenv_ipc("get_stats", buf, sizeof(buf)) < 0)
+		return -1;
+	return xenv_statof(buf, section, key);
+}
+
+long
+xenv_statof(const char *reply, const char *section, const char *key)
+{
+	char pat[64];
+	const char *p;
+
+	snprintf(pat, sizeof(pat), "\"%s\":{", section);
+	if (!(p = strstr(reply, pat)))
+		return -1;
+	snprintf(pat, sizeof(pat), "\"%s\":", key);
+	if (!(p = strstr(p, pat)))
+		return -1;
+	return strtol(p + strlen(pat), NULL, 10);
+}
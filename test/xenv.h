@@ -0,0 +1,33 @@
+/* See LICENSE file for copyright and license details. */
+
+/* A dwm of this tree on a private Xvfb, for the tests and benchmarks that
+ * need an X server. */
+
+/* Starts Xvfb and ./dwm and connects to both. Returns the display, or NULL
+ * if there is no Xvfb to run. */
+Display *xenv_start(void);
+void xenv_stop(void);
+
+/* The two halves of xenv_start(): Xvfb alone, then a window manager of
+ * argv, which may be started and stopped again. xenv_wm() returns 0 if the
+ * program is missing or does not open its ipc socket. */
+Display *xenv_server(void);
+int xenv_wm(char *const argv[]);
+void xenv_wmstop(void);
+
+/* Sends one ipc request line and reads the reply line into buf. Returns
+ * the length of the reply or -1. */
+int xenv_ipc(const char *req, char *buf, size_t size);
+
+/* Maps a w x h window and waits until dwm manages it. */
+Window xenv_client(const char *title, int w, int h);
+
+/* Waits until dwm manages the mapped win, returns 0 if it does not. */
+int xenv_managed(Window win);
+
+/* Returns a number from the get_stats reply of key in section, or -1,
+ * asking dwm for it or taking it from an earlier reply. */
+long xenv_stat(const char *section, const char *key);
+long xenv_statof(const char *reply, const char *section, const char *key);
+
+void xenv_sleep(long us);
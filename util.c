@@ -1,4 +1,5 @@
 /* See LICENSE file for copyright and license details. */
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,6 +7,8 @@
 
 #include "util.h"
 
+#define SLABSIZE  4096
+
 void *
 ecalloc(size_t nmemb, size_t size)
 {
@@ -33,3 +36,50 @@ die(const char *fmt, ...) {
 
 	exit(1);
 }
+
+/* Returns a zeroed object. Objects start on a cache line, so the first
+ * line of each holds its hottest fields undisturbed by its neighbours. */
+void *
+pool_alloc(Pool *p)
+{
+	char *slab, *o;
+	size_t i, n;
+
+	if (!p->free) {
+		p->size = (p->size + CACHELINE - 1) & ~(size_t)(CACHELINE - 1);
+		n = MAX(1, (SLABSIZE - CACHELINE) / p->size);
+		if ((errno = posix_memalign((void **)&slab, CACHELINE, CACHELINE + n * p->size)))
+			die("posix_memalign:");
+		*(void **)slab = p->slabs;
+		p->slabs = slab;
+		for (i = n; i > 0; i--) {
+			o = slab + CACHELINE + (i - 1) * p->size;
+			*(void **)o = p->free;
+			p->free = o;
+		}
+	}
+	o = p->free;
+	p->free = *(void **)o;
+	memset(o, 0, p->size);
+	return o;
+}
+
+void
+pool_free(Pool *p, void *o)
+{
+	*(void **)o = p->free;
+	p->free = o;
+}
+
+/* Frees all slabs, every object must have been returned. */
+void
+pool_release(Pool *p)
+{
+	void *slab;
+
+	while ((slab = p->slabs)) {
+		p->slabs = *(void **)slab;
+		free(slab);
+	}
+	p->free = NULL;
+}
@@ -6,3 +6,16 @@
 
 void die(const char *fmt, ...);
 void *ecalloc(size_t nmemb, size_t size);
+
+#define CACHELINE               64
+
+/* fixed-size objects carved from cache-line aligned slabs */
+typedef struct {
+	size_t size;    /* object size, a multiple of a cache line once used */
+	void *free;     /* free objects, linked through their first word */
+	void *slabs;    /* slabs, linked through their first line */
+} Pool;
+
+void *pool_alloc(Pool *p);
+void pool_free(Pool *p, void *o);
+void pool_release(Pool *p);